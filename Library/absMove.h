@@ -7,14 +7,18 @@
 #include <string.h>
 #include <signal.h>
 #include <math.h>
+#include "injector.h"
+#include "deviceReady.h"
+#include "log.h"
+#include "trace.h"
 
-// Screen dimensions
+// ABS range used when no wayland output is known at creation time
 #define SCREEN_WIDTH  1920
 #define SCREEN_HEIGHT 1080
 
 typedef struct {
     int fd;
-    int screen_width;
+    int screen_width;   // ABS_X/ABS_Y range the device was created with
     int screen_height;
     int is_pressed;
     int last_x, last_y;
@@ -33,13 +37,13 @@ extern void destroy_tablet() {
             ev.type = EV_KEY;
             ev.code = BTN_TOUCH;
             ev.value = 0;
-            write(tablet.fd, &ev, sizeof(ev));
+            output_write(tablet.fd, &ev, 1);
             
             memset(&ev, 0, sizeof(ev));
             ev.type = EV_SYN;
             ev.code = SYN_REPORT;
             ev.value = 0;
-            write(tablet.fd, &ev, sizeof(ev));
+            output_write(tablet.fd, &ev, 1);
         }
         
         ioctl(tablet.fd, UI_DEV_DESTROY);
@@ -50,53 +54,104 @@ extern void destroy_tablet() {
     return;
 }
 
-extern int init_tablet() {
-    if (tablet.fd >= 0) return 0;
-    
-    tablet.fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
-    if (tablet.fd < 0) {
-        perror("Failed to open /dev/uinput");
-        return -1;
+// Sizes the ABS range to the virtual desktop discovered by init_layer_shell,
+// so one unit is one pixel until the outputs change.
+static void tablet_size_from_outputs() {
+    ScreenMetrics metrics;
+    read_screen_metrics(&metrics);
+    if (metrics.virtual_width > 0 && metrics.virtual_height > 0) {
+        tablet.screen_width = metrics.virtual_width;
+        tablet.screen_height = metrics.virtual_height;
     }
+}
+
+// Maps a point in global desktop coordinates onto the ABS range. After a
+// mode change or hotplug the range no longer matches the desktop, so the
+// point is rescaled instead of recreating the device. Returns false when
+// the point lies outside the desktop.
+static bool tablet_map_point(int x, int y, int *abs_x, int *abs_y) {
+    ScreenMetrics metrics;
+    read_screen_metrics(&metrics);
+    if (metrics.virtual_width <= 0 || metrics.virtual_height <= 0) {
+        // no outputs known, treat coordinates as ABS units
+        metrics.virtual_x = metrics.virtual_y = 0;
+        metrics.virtual_width = tablet.screen_width;
+        metrics.virtual_height = tablet.screen_height;
+    }
+    x -= metrics.virtual_x;
+    y -= metrics.virtual_y;
+    if (x < 0 || x >= metrics.virtual_width || y < 0 || y >= metrics.virtual_height) {
+        return false;
+    }
+    if (metrics.virtual_width == tablet.screen_width && metrics.virtual_height == tablet.screen_height) {
+        *abs_x = x;
+        *abs_y = y;
+        return true;
+    }
+    int span_x = metrics.virtual_width > 1 ? metrics.virtual_width - 1 : 1;
+    int span_y = metrics.virtual_height > 1 ? metrics.virtual_height - 1 : 1;
+    *abs_x = (int)((int64_t)x * (tablet.screen_width - 1) / span_x);
+    *abs_y = (int)((int64_t)y * (tablet.screen_height - 1) / span_y);
+    return true;
+}
+
+// registers ABS_X/ABS_Y on dev_fd before UI_DEV_SETUP
+static void tablet_setup_axes(int dev_fd) {
+    tablet_size_from_outputs();
+    ioctl(dev_fd, UI_SET_EVBIT, EV_ABS);
     
-    
-    ioctl(tablet.fd, UI_SET_EVBIT, EV_ABS);
-    
-    ioctl(tablet.fd, UI_SET_ABSBIT, ABS_X);
+    ioctl(dev_fd, UI_SET_ABSBIT, ABS_X);
     struct uinput_abs_setup abs_x;
     memset(&abs_x, 0, sizeof(abs_x));
     abs_x.code = ABS_X;
     abs_x.absinfo.minimum = 0;
     abs_x.absinfo.maximum = tablet.screen_width - 1;
     abs_x.absinfo.resolution = 100;  
-    ioctl(tablet.fd, UI_ABS_SETUP, &abs_x);
+    ioctl(dev_fd, UI_ABS_SETUP, &abs_x);
     
-    ioctl(tablet.fd, UI_SET_ABSBIT, ABS_Y);
+    ioctl(dev_fd, UI_SET_ABSBIT, ABS_Y);
     struct uinput_abs_setup abs_y;
     memset(&abs_y, 0, sizeof(abs_y));
     abs_y.code = ABS_Y;
     abs_y.absinfo.minimum = 0;
     abs_y.absinfo.maximum = tablet.screen_height - 1;
     abs_y.absinfo.resolution = 100;
-    ioctl(tablet.fd, UI_ABS_SETUP, &abs_y);
-    
-    ioctl(tablet.fd, UI_SET_ABSBIT, ABS_PRESSURE);
+    ioctl(dev_fd, UI_ABS_SETUP, &abs_y);
+}
+
+// registers the tablet axes and buttons on dev_fd before UI_DEV_SETUP
+static void tablet_setup_bits(int dev_fd) {
+    tablet_setup_axes(dev_fd);
+
+    ioctl(dev_fd, UI_SET_ABSBIT, ABS_PRESSURE);
     struct uinput_abs_setup abs_pressure;
     memset(&abs_pressure, 0, sizeof(abs_pressure));
     abs_pressure.code = ABS_PRESSURE;
     abs_pressure.absinfo.minimum = 0;
     abs_pressure.absinfo.maximum = 1024;  
-    ioctl(tablet.fd, UI_ABS_SETUP, &abs_pressure);
+    ioctl(dev_fd, UI_ABS_SETUP, &abs_pressure);
     
     
-    ioctl(tablet.fd, UI_SET_EVBIT, EV_KEY);
-    ioctl(tablet.fd, UI_SET_KEYBIT, BTN_TOUCH);      
-    ioctl(tablet.fd, UI_SET_KEYBIT, BTN_STYLUS);     
-    ioctl(tablet.fd, UI_SET_KEYBIT, BTN_STYLUS2);   
-    ioctl(tablet.fd, UI_SET_KEYBIT, BTN_LEFT);      
-    ioctl(tablet.fd, UI_SET_KEYBIT, BTN_RIGHT);      
+    ioctl(dev_fd, UI_SET_EVBIT, EV_KEY);
+    ioctl(dev_fd, UI_SET_KEYBIT, BTN_TOUCH);      
+    ioctl(dev_fd, UI_SET_KEYBIT, BTN_STYLUS);     
+    ioctl(dev_fd, UI_SET_KEYBIT, BTN_STYLUS2);   
+    ioctl(dev_fd, UI_SET_KEYBIT, BTN_LEFT);      
+    ioctl(dev_fd, UI_SET_KEYBIT, BTN_RIGHT);
+}
+
+extern int init_tablet() {
+    if (tablet.fd >= 0) return 0;
+    
+    tablet.fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (tablet.fd < 0) {
+        perror("Failed to open /dev/uinput");
+        return -1;
+    }
     
     
+    tablet_setup_bits(tablet.fd);
+    
     ioctl(tablet.fd, UI_SET_EVBIT, EV_SYN);
     
    
@@ -108,16 +163,18 @@ extern int init_tablet() {
     usetup.id.version = 1;
     strcpy(usetup.name, "Virtual Tablet");
     
+    DeviceWatch watch;
+    device_watch_start(&watch);
     if (ioctl(tablet.fd, UI_DEV_SETUP, &usetup) < 0 ||
         ioctl(tablet.fd, UI_DEV_CREATE) < 0) {
         perror("Failed to create tablet");
+        device_watch_stop(&watch);
         close(tablet.fd);
         tablet.fd = -1;
         return -1;
     }
     
-    
-    usleep(1000000); 
+    device_wait_ready(tablet.fd, &watch);
     
     
     tablet.last_x = tablet.screen_width / 2;
@@ -137,14 +194,14 @@ void send_absolute(int x, int y) {
     ev.type = EV_ABS;
     ev.code = ABS_X;
     ev.value = x;
-    write(tablet.fd, &ev, sizeof(ev));
+    output_write(tablet.fd, &ev, 1);
     
     
     memset(&ev, 0, sizeof(ev));
     ev.type = EV_ABS;
     ev.code = ABS_Y;
     ev.value = y;
-    write(tablet.fd, &ev, sizeof(ev));
+    output_write(tablet.fd, &ev, 1);
     
     
     
@@ -152,10 +209,7 @@ void send_absolute(int x, int y) {
     ev.type = EV_SYN;
     ev.code = SYN_REPORT;
     ev.value = 0;
-    write(tablet.fd, &ev, sizeof(ev));
-    
-    tablet.last_x = x;
-    tablet.last_y = y;
+    output_write(tablet.fd, &ev, 1);
     
     usleep(1000);  // 10ms delay
 }
@@ -163,20 +217,32 @@ void send_absolute(int x, int y) {
 
 extern void SetCursorPos(int x, int y) {
     if (tablet.fd < 0) {
-        printf("Tablet not initialized!\n");
+        LOG_ERROR("Tablet not initialized!\n");
         return;
     }
     
     
-    if (x < 0 || x >= tablet.screen_width || 
-        y < 0 || y >= tablet.screen_height) {
-        printf("Position (%d, %d) out of bounds (0-%d, 0-%d)\n",
-               x, y, tablet.screen_width-1, tablet.screen_height-1);
+    int abs_x, abs_y;
+    if (!tablet_map_point(x, y, &abs_x, &abs_y)) {
+        LOG_DEBUG("Position (%d, %d) is outside the desktop\n", x, y);
         return;
     }
     
-    printf("Moving to ABSOLUTE position: (%d, %d)\n", x, y);
-    send_absolute(x, y); 
+    LOG_DEBUG("Moving to ABSOLUTE position: (%d, %d)\n", x, y);
+    TRACE(TRACE_SET_CURSOR_POS, x, y, 0);
+    tablet.last_x = x;
+    tablet.last_y = y;
+    if (injector_enter()) {
+        size_t pos = injector_reserve(1);
+        InputFrame *frame = injector_frame(pos);
+        frame_init(frame, tablet.fd);
+        frame_add(frame, EV_ABS, ABS_X, abs_x);
+        frame_add(frame, EV_ABS, ABS_Y, abs_y);
+        injector_publish(pos, 1);
+        injector_leave();
+        return;
+    }
+    send_absolute(abs_x, abs_y); 
 }
 
 
@@ -0,0 +1,276 @@
+// bench.c - latency and throughput of the injection and query APIs
+//
+// Drives SendInput, SetCursorPos, mouseMove, GetKeyState, GetKeyboardState
+// and GetCursorPos against a mock event sink (pipe, memfd or the recording
+// backend) or real /dev/uinput devices and reports events/sec, write
+// syscalls per event and p50/p99/p99.9 call latency.
+//
+//   gcc -O2 -o bench bench.c tmp/*-v1.c tmp/viewporter.c tmp/presentation-time.c -I./tmp
+//       -lwayland-client -linput -ludev -lpthread
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "lib.h"
+
+typedef enum { SINK_PIPE, SINK_MEMFD, SINK_UINPUT, SINK_RECORD } SinkType;
+
+const char *sink_names[] = { "pipe", "memfd", "uinput", "record" };
+
+SinkType sink_type = SINK_PIPE;
+int iterations = 10000;
+int batch_size = 16;
+int rate = 0;  // calls per second, 0 for unpaced
+
+int sink_fd = -1;
+int sink_read_fd = -1;
+pthread_t sink_thread;
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// write syscalls issued by this process so far, -1 if /proc/self/io is unavailable
+static long write_syscalls() {
+    FILE *f = fopen("/proc/self/io", "r");
+    if (!f) return -1;
+    char line[128];
+    long count = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "syscw: %ld", &count) == 1) break;
+    }
+    fclose(f);
+    return count;
+}
+
+static void *drain_sink(void *arg) {
+    char buf[65536];
+    while (read(sink_read_fd, buf, sizeof(buf)) > 0) {
+    }
+    return NULL;
+}
+
+static int open_sink() {
+    switch (sink_type) {
+        case SINK_PIPE: {
+            int p[2];
+            if (pipe(p) < 0) {
+                perror("pipe");
+                return -1;
+            }
+            fcntl(p[1], F_SETPIPE_SZ, 1 << 20);
+            sink_read_fd = p[0];
+            sink_fd = p[1];
+            pthread_create(&sink_thread, NULL, drain_sink, NULL);
+            break;
+        }
+        case SINK_MEMFD:
+            sink_fd = memfd_create("bench-sink", MFD_CLOEXEC);
+            if (sink_fd < 0) {
+                perror("memfd_create");
+                return -1;
+            }
+            break;
+        case SINK_UINPUT:
+            if (init_tablet() < 0 || init_virtual_mouse() < 0 || initilize_keyboard() != 0) {
+                fprintf(stderr, "uinput not available, run as a user with access to /dev/uinput\n");
+                return -1;
+            }
+            return 0;
+        case SINK_RECORD:
+            UseRecordingBackend();
+            return 0;
+    }
+    tablet.fd = sink_fd;
+    fd = sink_fd;
+    fd_k = sink_fd;
+    return 0;
+}
+
+static void close_sink() {
+    if (sink_type == SINK_UINPUT) {
+        destroy_tablet();
+        destroy_virtual_mouse();
+        destroy_keyboard();
+        return;
+    }
+    if (sink_type == SINK_RECORD) return;
+    close(sink_fd);
+    if (sink_type == SINK_PIPE) {
+        pthread_join(sink_thread, NULL);
+        close(sink_read_fd);
+    }
+}
+
+static void rewind_sink() {
+    if (sink_type == SINK_MEMFD) {
+        ftruncate(sink_fd, 0);
+        lseek(sink_fd, 0, SEEK_SET);
+    } else if (sink_type == SINK_RECORD) {
+        ClearRecordedEvents();
+    }
+}
+
+static int compare_ns(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int64_t percentile(int64_t *sorted, int n, double p) {
+    int index = (int)(p * (n - 1));
+    return sorted[index];
+}
+
+typedef void (*BenchCall)(int i);
+
+// runs call iterations times; events_per_call is what one call injects,
+// 0 for query APIs which are reported in calls/s
+static void run_bench(const char *name, BenchCall call, int events_per_call) {
+    int64_t *samples = malloc(sizeof(int64_t) * iterations);
+    int64_t interval = rate > 0 ? 1000000000LL / rate : 0;
+
+    rewind_sink();
+    long syscalls_before = write_syscalls();
+    int64_t start = now_ns();
+    int64_t next = start;
+    for (int i = 0; i < iterations; i++) {
+        if (interval > 0) {
+            next += interval;
+            struct timespec ts = { next / 1000000000, next % 1000000000 };
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        }
+        int64_t t0 = now_ns();
+        call(i);
+        samples[i] = now_ns() - t0;
+    }
+    FlushInput();
+    int64_t elapsed = now_ns() - start;
+    long syscalls_after = write_syscalls();
+
+    qsort(samples, iterations, sizeof(int64_t), compare_ns);
+    long events = (long)iterations * events_per_call;
+    if (events > 0) {
+        printf("%-16s %12.0f ev/s   ", name, events * 1e9 / elapsed);
+    } else {
+        printf("%-16s %12.0f calls/s", name, iterations * 1e9 / elapsed);
+    }
+    if (events > 0 && syscalls_before >= 0) {
+        printf("  %6.3f writes/ev", (double)(syscalls_after - syscalls_before) / events);
+    } else {
+        printf("  %6s writes/ev", "-");
+    }
+    printf("  p50 %8.2f us  p99 %8.2f us  p99.9 %8.2f us\n",
+           percentile(samples, iterations, 0.50) / 1000.0,
+           percentile(samples, iterations, 0.99) / 1000.0,
+           percentile(samples, iterations, 0.999) / 1000.0);
+    free(samples);
+}
+
+INPUT *key_batch;
+INPUT *move_batch;
+
+static void call_send_keys(int i) {
+    SendInput(batch_size, key_batch, sizeof(INPUT));
+}
+
+static void call_send_moves(int i) {
+    SendInput(batch_size, move_batch, sizeof(INPUT));
+}
+
+static void call_set_cursor_pos(int i) {
+    SetCursorPos(100 + (i & 255), 100 + (i & 127));
+}
+
+static void call_mouse_move(int i) {
+    mouseMove((i & 1) ? 1 : -1, 0);
+}
+
+static void call_get_key_state(int i) {
+    volatile short state = GetKeyState(VK_A + (i % 26));
+    (void)state;
+}
+
+static void call_get_keyboard_state(int i) {
+    static BYTE state[256];
+    GetKeyboardState(state);
+    __asm__ volatile("" : : "r"(state) : "memory");
+}
+
+static void call_get_cursor_pos(int i) {
+    POINT point;
+    GetCursorPos(&point);
+}
+
+static void bench_usage() {
+    printf("bench - injection latency and throughput.\n\n");
+    printf("Options:\n");
+    printf("  -n <int>    : calls per API (default 10000).\n");
+    printf("  -b <int>    : INPUTs per SendInput call (default 16).\n");
+    printf("  -r <int>    : calls per second, 0 for unpaced (default 0).\n");
+    printf("  -s <sink>   : pipe, memfd, record or uinput (default pipe).\n");
+    printf("  -a          : use the asynchronous injector.\n");
+    printf("  -h          : show this message.\n");
+    exit(0);
+}
+
+int main(int argc, char *argv[]) {
+    ARGBEGIN {
+    case 'n':
+        iterations = atoi(EARGF(bench_usage()));
+        break;
+    case 'b':
+        batch_size = atoi(EARGF(bench_usage()));
+        break;
+    case 'r':
+        rate = atoi(EARGF(bench_usage()));
+        break;
+    case 's': {
+        char *sink = EARGF(bench_usage());
+        if (strcmp(sink, "memfd") == 0) sink_type = SINK_MEMFD;
+        else if (strcmp(sink, "uinput") == 0) sink_type = SINK_UINPUT;
+        else if (strcmp(sink, "record") == 0) sink_type = SINK_RECORD;
+        else sink_type = SINK_PIPE;
+        break;
+    }
+    case 'a':
+        async_input = true;
+        break;
+    default:
+        bench_usage();
+    } ARGEND;
+
+    if (iterations <= 0 || batch_size <= 0) bench_usage();
+    if (open_sink() < 0) return 1;
+    if (async_input) start_injector();
+
+    key_batch = calloc(batch_size, sizeof(INPUT));
+    move_batch = calloc(batch_size, sizeof(INPUT));
+    for (int i = 0; i < batch_size; i++) {
+        key_batch[i].type = INPUT_KEYBOARD;
+        key_batch[i].ki.wVk = VK_A;
+        key_batch[i].ki.dwFlags = (i & 1) ? KEYEVENTF_KEYUP : 0;
+        move_batch[i].type = INPUT_MOUSE;
+        move_batch[i].mi.dx = (i & 1) ? 1 : -1;
+        move_batch[i].mi.dwFlags = MOUSEEVENTF_MOVE;
+    }
+
+    printf("sink: %s, calls: %d, batch: %d, rate: %d/s, async: %s\n",
+           sink_names[sink_type],
+           iterations, batch_size, rate, async_input ? "yes" : "no");
+    run_bench("SendInput/key", call_send_keys, batch_size);
+    run_bench("SendInput/move", call_send_moves, batch_size);
+    run_bench("SetCursorPos", call_set_cursor_pos, 1);
+    run_bench("mouseMove", call_mouse_move, 1);
+    run_bench("GetKeyState", call_get_key_state, 0);
+    run_bench("GetKeyboardState", call_get_keyboard_state, 0);
+    run_bench("GetCursorPos", call_get_cursor_pos, 0);
+
+    stop_injector();
+    close_sink();
+    free(key_batch);
+    free(move_batch);
+    return 0;
+}
@@ -0,0 +1,76 @@
+// compositeDevice.h - one uinput device carrying keyboard, mouse and absolute pointer events
+#ifndef COMPOSITE_DEVICE_H
+#define COMPOSITE_DEVICE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/uinput.h>
+
+// set before MAIN_INIT to create a single composite device instead of three
+bool composite_device = false;
+int fd_composite = -1;
+
+// Registers ABS_X/ABS_Y with the mouse and keyboard capabilities and points
+// tablet.fd, fd and fd_k at the same device, so a mixed SendInput batch is one
+// write and one device shows up in the compositor. The stylus, touch and
+// pressure bits stay off: with them udev tags the node as a tablet and
+// libinput's tablet dispatch drops the keys and relative motion. Without
+// them it is an absolute pointer that also has keys.
+extern int init_composite_device() {
+    if (fd_composite >= 0) return 0;
+
+    fd_composite = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (fd_composite < 0) {
+        perror("Failed to open /dev/uinput");
+        return -1;
+    }
+
+    tablet_setup_axes(fd_composite);
+    mouse_setup_bits(fd_composite);
+    keyboard_setup_bits(fd_composite);
+    ioctl(fd_composite, UI_SET_EVBIT, EV_SYN);
+
+    struct uinput_setup usetup;
+    memset(&usetup, 0, sizeof(usetup));
+    usetup.id.bustype = BUS_USB;
+    usetup.id.vendor = 0x1234;
+    usetup.id.product = 0x5679;
+    usetup.id.version = 1;
+    strcpy(usetup.name, "Virtual Composite Input");
+
+    DeviceWatch watch;
+    device_watch_start(&watch);
+    if (ioctl(fd_composite, UI_DEV_SETUP, &usetup) < 0 ||
+        ioctl(fd_composite, UI_DEV_CREATE) < 0) {
+        perror("Failed to create composite device");
+        device_watch_stop(&watch);
+        close(fd_composite);
+        fd_composite = -1;
+        return -1;
+    }
+
+    device_wait_ready(fd_composite, &watch);
+
+    tablet.fd = fd_composite;
+    tablet.last_x = tablet.screen_width / 2;
+    tablet.last_y = tablet.screen_height / 2;
+    fd = fd_composite;
+    fd_k = fd_composite;
+    return 0;
+}
+
+extern void destroy_composite_device() {
+    if (fd_composite < 0) return;
+
+    ioctl(fd_composite, UI_DEV_DESTROY);
+    close(fd_composite);
+    fd_composite = -1;
+    tablet.fd = -1;
+    fd = -1;
+    fd_k = -1;
+}
+
+#endif
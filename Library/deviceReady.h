@@ -0,0 +1,110 @@
+// deviceReady.h - wait for a new uinput device to be announced by udev
+#ifndef DEVICE_READY_H
+#define DEVICE_READY_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <linux/uinput.h>
+#include <libudev.h>
+
+// upper bound on how long a device creation waits for udev
+#define DEVICE_READY_TIMEOUT_MS 1000
+
+typedef struct {
+    struct udev *udev;
+    struct udev_monitor *monitor;
+} DeviceWatch;
+
+static int64_t ready_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Must be called before UI_DEV_CREATE so the add event cannot be missed.
+static void device_watch_start(DeviceWatch *watch) {
+    watch->monitor = NULL;
+    watch->udev = udev_new();
+    if (!watch->udev) return;
+
+    watch->monitor = udev_monitor_new_from_netlink(watch->udev, "udev");
+    if (watch->monitor == NULL ||
+        udev_monitor_filter_add_match_subsystem_devtype(watch->monitor, "input", NULL) < 0 ||
+        udev_monitor_enable_receiving(watch->monitor) < 0) {
+        if (watch->monitor) udev_monitor_unref(watch->monitor);
+        watch->monitor = NULL;
+    }
+}
+
+static void device_watch_stop(DeviceWatch *watch) {
+    if (watch->monitor) udev_monitor_unref(watch->monitor);
+    if (watch->udev) udev_unref(watch->udev);
+    watch->monitor = NULL;
+    watch->udev = NULL;
+}
+
+// Blocks until udev has processed the event node of the uinput device behind
+// dev_fd (the point where libinput-based compositors pick it up), or until
+// DEVICE_READY_TIMEOUT_MS passes. Returns the time waited in ms, -1 on timeout.
+static int device_wait_ready(int dev_fd, DeviceWatch *watch) {
+    int64_t start = ready_now_ms();
+    char sysname[64];
+
+    if (watch->monitor == NULL ||
+        ioctl(dev_fd, UI_GET_SYSNAME(sizeof(sysname)), sysname) < 0) {
+        // no way to observe the device, fall back to the fixed wait
+        usleep(DEVICE_READY_TIMEOUT_MS * 1000);
+        device_watch_stop(watch);
+        return -1;
+    }
+
+    int result = -1;
+    int monitor_fd = udev_monitor_get_fd(watch->monitor);
+    int remaining = DEVICE_READY_TIMEOUT_MS;
+    while (remaining > 0 && result < 0) {
+        struct pollfd pfd = { .fd = monitor_fd, .events = POLLIN };
+        if (poll(&pfd, 1, remaining) <= 0) break;
+
+        struct udev_device *dev;
+        while ((dev = udev_monitor_receive_device(watch->monitor)) != NULL) {
+            const char *action = udev_device_get_action(dev);
+            struct udev_device *parent = udev_device_get_parent(dev);
+            if (action && strcmp(action, "add") == 0 &&
+                udev_device_get_devnode(dev) != NULL && parent != NULL &&
+                strcmp(udev_device_get_sysname(parent), sysname) == 0) {
+                result = ready_now_ms() - start;
+            }
+            udev_device_unref(dev);
+        }
+        remaining = DEVICE_READY_TIMEOUT_MS - (int)(ready_now_ms() - start);
+    }
+
+    if (result < 0) {
+        fprintf(stderr, "%s was not announced within %d ms\n", sysname, DEVICE_READY_TIMEOUT_MS);
+    }
+    device_watch_stop(watch);
+    return result;
+}
+
+// Whether the uinput device behind dev_fd owns /dev/input/<event_name>, so
+// key readers can leave out the keys we inject ourselves.
+static bool uinput_owns_node(int dev_fd, const char *event_name) {
+    char sysname[64];
+    if (dev_fd < 0 || ioctl(dev_fd, UI_GET_SYSNAME(sizeof(sysname)), sysname) < 0) {
+        return false;
+    }
+    char link[PATH_MAX], target[PATH_MAX];
+    snprintf(link, sizeof(link), "/sys/class/input/%s/device", event_name);
+    ssize_t len = readlink(link, target, sizeof(target) - 1);
+    if (len < 0) return false;
+    target[len] = '\0';
+    const char *base = strrchr(target, '/');
+    return strcmp(base ? base + 1 : target, sysname) == 0;
+}
+
+#endif
@@ -0,0 +1,242 @@
+// evdevKeys.h - key state read straight from the keyboard event nodes
+#ifndef EVDEV_KEYS_H
+#define EVDEV_KEYS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+#include "keyState.h"
+#include "hooks.h"
+#include "latency.h"
+#include "eventLoop.h"
+
+// Set before MAIN_INIT to track keys from /dev/input/event* instead of
+// libinput. Both backends leave out the keys we inject through our own
+// uinput keyboard or composite device, so GetKeyState only sees typed keys.
+// Mouse buttons are not filtered: libinput reports them on the libinput
+// path (without the composite device's, it is disabled there as a whole),
+// the compositor otherwise.
+bool raw_key_state = false;
+
+#define EVDEV_MAX_DEVICES 8
+#define EVDEV_READ_BATCH 64
+
+typedef struct {
+    int fd;
+    bool dropped;  // SYN_DROPPED seen, events are discarded until SYN_REPORT
+    uint64_t down[KEY_STATE_WORDS];
+} EvdevKeyboard;
+
+EvdevKeyboard evdev_keyboards[EVDEV_MAX_DEVICES];
+int evdev_keyboard_count = 0;
+
+static bool evdev_bit(const uint64_t *bits, unsigned int code) {
+    return (bits[code / 64] >> (code % 64)) & 1;
+}
+
+// the key is down on the seat while any keyboard holds it
+static bool evdev_key_held(unsigned int code) {
+    for (int i = 0; i < evdev_keyboard_count; i++) {
+        if (evdev_keyboards[i].fd >= 0 && evdev_bit(evdev_keyboards[i].down, code)) return true;
+    }
+    return false;
+}
+
+static void evdev_key_change(EvdevKeyboard *kb, unsigned int code, bool down) {
+    if (code >= KEY_CNT || evdev_bit(kb->down, code) == down) return;
+    uint64_t mask = 1ull << (code % 64);
+    if (down) {
+        kb->down[code / 64] |= mask;
+        key_state_set(code, true);
+    } else {
+        kb->down[code / 64] &= ~mask;
+        if (!evdev_key_held(code)) key_state_set(code, false);
+    }
+}
+
+// Replaces what we believe is held on kb with what the kernel reports,
+// used at startup and after the kernel dropped events for us.
+static void evdev_sync_keys(EvdevKeyboard *kb) {
+    uint64_t current[KEY_STATE_WORDS];
+    memset(current, 0, sizeof(current));
+    if (ioctl(kb->fd, EVIOCGKEY(sizeof(current)), current) < 0) {
+        perror("EVIOCGKEY");
+        return;
+    }
+    key_state_write_begin();
+    for (int word = 0; word < KEY_STATE_WORDS; word++) {
+        uint64_t changed = current[word] ^ kb->down[word];
+        while (changed) {
+            unsigned int bit = __builtin_ctzll(changed);
+            changed &= changed - 1;
+            evdev_key_change(kb, word * 64 + bit, (current[word] >> bit) & 1);
+        }
+    }
+    key_state_write_end();
+}
+
+static void evdev_close_keyboard(EvdevKeyboard *kb) {
+    event_loop_remove_fd(kb->fd);
+    close(kb->fd);
+    kb->fd = -1;
+    // whatever it held is released unless another keyboard holds it too
+    key_state_write_begin();
+    for (int word = 0; word < KEY_STATE_WORDS; word++) {
+        uint64_t held = kb->down[word];
+        kb->down[word] = 0;
+        while (held) {
+            unsigned int code = word * 64 + __builtin_ctzll(held);
+            held &= held - 1;
+            if (!evdev_key_held(code)) key_state_set(code, false);
+        }
+    }
+    key_state_write_end();
+}
+
+// Event loop handler: reads EVDEV_READ_BATCH events per syscall until the
+// node is empty and publishes the whole batch as one key-state update.
+static void evdev_keys_readable(void *data, uint32_t events) {
+    EvdevKeyboard *kb = data;
+    struct input_event buf[EVDEV_READ_BATCH];
+
+    key_state_write_begin();
+    for (;;) {
+        ssize_t n = read(kb->fd, buf, sizeof(buf));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN) {
+                // ENODEV: the keyboard was unplugged
+                key_state_write_end();
+                evdev_close_keyboard(kb);
+                return;
+            }
+            break;
+        }
+        if (n == 0) break;
+        int count = n / sizeof(struct input_event);
+        for (int i = 0; i < count; i++) {
+            struct input_event *ev = &buf[i];
+            if (ev->type == EV_SYN) {
+                if (ev->code == SYN_DROPPED) {
+                    kb->dropped = true;
+                } else if (ev->code == SYN_REPORT && kb->dropped) {
+                    kb->dropped = false;
+                    evdev_sync_keys(kb);
+                }
+            } else if (ev->type == EV_KEY && !kb->dropped) {
+                // value 2 is autorepeat and changes nothing
+                if (ev->value != 2) {
+                    uint64_t time_us = (uint64_t)ev->input_event_sec * 1000000 + ev->input_event_usec;
+                    latency_observed(time_us);
+                    evdev_key_change(kb, ev->code, ev->value != 0);
+                    hook_keyboard_event(ev->code, ev->value != 0, time_us / 1000);
+                }
+            }
+        }
+        if (count < EVDEV_READ_BATCH) break;
+    }
+    key_state_write_end();
+}
+
+// Only nodes with every letter key count, which leaves out power and lid
+// buttons, media remotes and mice.
+static bool evdev_is_keyboard(int dev_fd) {
+    static const unsigned int letter_rows[][2] = {
+        { KEY_Q, KEY_P }, { KEY_A, KEY_L }, { KEY_Z, KEY_M },
+    };
+    uint64_t keys[KEY_STATE_WORDS];
+    memset(keys, 0, sizeof(keys));
+    if (ioctl(dev_fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) < 0) return false;
+    for (int row = 0; row < 3; row++) {
+        for (unsigned int code = letter_rows[row][0]; code <= letter_rows[row][1]; code++) {
+            if (!evdev_bit(keys, code)) return false;
+        }
+    }
+    return true;
+}
+
+// Our own uinput keyboard and composite device would feed injected keys
+// back into the state as if they had been typed. fd_k and fd_composite
+// come from keyboard.h and compositeDevice.h, included first by lib.h.
+static bool evdev_is_own_device(const char *event_name) {
+    return uinput_owns_node(fd_k, event_name) || uinput_owns_node(fd_composite, event_name);
+}
+
+// Opens every keyboard node except our own uinput devices, seeds the state
+// with what is already held and registers the nodes with the event loop. Needs read access to
+// /dev/input/event*. Keyboards plugged in later are not picked up.
+extern int init_evdev_keys() {
+    DIR *dir = opendir("/dev/input");
+    if (dir == NULL) {
+        perror("Failed to open /dev/input");
+        return -1;
+    }
+    struct dirent *entry;
+    int skipped = 0;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "event", 5) != 0) continue;
+        if (evdev_is_own_device(entry->d_name)) continue;
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "/dev/input/%s", entry->d_name);
+        int dev_fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (dev_fd < 0) continue;
+        if (!evdev_is_keyboard(dev_fd)) {
+            close(dev_fd);
+            continue;
+        }
+        if (evdev_keyboard_count == EVDEV_MAX_DEVICES) {
+            close(dev_fd);
+            skipped++;
+            continue;
+        }
+        // event times on the same clock as libinput and wayland
+        int clock = CLOCK_MONOTONIC;
+        ioctl(dev_fd, EVIOCSCLOCKID, &clock);
+        EvdevKeyboard *kb = &evdev_keyboards[evdev_keyboard_count];
+        memset(kb, 0, sizeof(*kb));
+        kb->fd = dev_fd;
+        evdev_keyboard_count++;
+        // seed before the loop can deliver events for this node
+        evdev_sync_keys(kb);
+        key_state_sync_leds(kb->fd);
+        if (event_loop_add_fd(dev_fd, EPOLLIN, evdev_keys_readable, kb) < 0) {
+            evdev_close_keyboard(kb);
+        }
+    }
+    closedir(dir);
+    if (skipped > 0) {
+        fprintf(stderr, "%d keyboard(s) not read, only %d are supported\n",
+                skipped, EVDEV_MAX_DEVICES);
+    }
+    int open_count = 0;
+    for (int i = 0; i < evdev_keyboard_count; i++) {
+        if (evdev_keyboards[i].fd >= 0) open_count++;
+    }
+    if (open_count == 0) {
+        fprintf(stderr, "No readable keyboard found in /dev/input\n");
+        return -1;
+    }
+    return 0;
+}
+
+extern void destroy_evdev_keys() {
+    for (int i = 0; i < evdev_keyboard_count; i++) {
+        if (evdev_keyboards[i].fd >= 0) {
+            event_loop_remove_fd(evdev_keyboards[i].fd);
+            close(evdev_keyboards[i].fd);
+            evdev_keyboards[i].fd = -1;
+        }
+    }
+    evdev_keyboard_count = 0;
+}
+
+#endif
@@ -0,0 +1,91 @@
+// eventBatch.h - per-device input_event buffers flushed with a single write
+#ifndef EVENT_BATCH_H
+#define EVENT_BATCH_H
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <linux/input.h>
+#include "outputBackend.h"
+
+// events buffered per device before a forced flush
+#define EVENT_BATCH_SIZE 256
+// events in one logical frame, SYN_REPORT not included
+#define FRAME_MAX_EVENTS 3
+
+typedef struct {
+    unsigned short type;
+    unsigned short code;
+    int value;
+} FrameEvent;
+
+// one translated INPUT: the device it targets and the events before SYN_REPORT
+typedef struct {
+    int fd;
+    int count;
+    FrameEvent events[FRAME_MAX_EVENTS];
+} InputFrame;
+
+typedef struct {
+    int fd;
+    size_t count;
+    struct input_event events[EVENT_BATCH_SIZE];
+} EventBatch;
+
+static void batch_init(EventBatch *batch, int fd) {
+    batch->fd = fd;
+    batch->count = 0;
+}
+
+// hands the buffered run to the output backend in one call, which for
+// uinput is a single write() of all events.
+static int batch_flush(EventBatch *batch) {
+    size_t count = batch->count;
+    batch->count = 0;
+    return output_write(batch->fd, batch->events, count);
+}
+
+static void batch_push(EventBatch *batch, int type, int code, int value) {
+    if (batch->count == EVENT_BATCH_SIZE) {
+        batch_flush(batch);
+    }
+    struct input_event *ie = &batch->events[batch->count++];
+    memset(ie, 0, sizeof(*ie));
+    ie->type = type;
+    ie->code = code;
+    ie->value = value;
+}
+
+// closes the current evdev frame
+static void batch_sync(EventBatch *batch) {
+    batch_push(batch, EV_SYN, SYN_REPORT, 0);
+}
+
+static void frame_init(InputFrame *frame, int fd) {
+    frame->fd = fd;
+    frame->count = 0;
+}
+
+static void frame_add(InputFrame *frame, int type, int code, int value) {
+    FrameEvent *fe = &frame->events[frame->count++];
+    fe->type = type;
+    fe->code = code;
+    fe->value = value;
+}
+
+// appends a whole frame, switching device (and flushing) when it targets another fd
+static void batch_frame(EventBatch *batch, const InputFrame *frame) {
+    if (frame->count == 0) return;
+    if (frame->fd != batch->fd) {
+        batch_flush(batch);
+        batch->fd = frame->fd;
+    }
+    for (int i = 0; i < frame->count; i++) {
+        batch_push(batch, frame->events[i].type, frame->events[i].code,
+                   frame->events[i].value);
+    }
+    batch_sync(batch);
+}
+
+#endif
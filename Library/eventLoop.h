@@ -0,0 +1,201 @@
+// eventLoop.h - one epoll thread for the wayland display and the key readers
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <wayland-client.h>
+
+#define EVENT_LOOP_MAX_SOURCES 16
+
+typedef void (*EventHandler)(void *data, uint32_t events);
+
+typedef struct {
+    int fd;
+    EventHandler handler;
+    void *data;
+} EventSource;
+
+struct {
+    int epoll_fd;
+    int shutdown_fd;
+    struct wl_display *display;
+    _Atomic bool running;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    EventSource sources[EVENT_LOOP_MAX_SOURCES];
+} event_loop = { .epoll_fd = -1, .shutdown_fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER };
+
+// markers in epoll_event.data for the two built-in sources
+#define EVENT_LOOP_DISPLAY  ((void *)&event_loop.display)
+#define EVENT_LOOP_SHUTDOWN ((void *)&event_loop.shutdown_fd)
+
+static int event_loop_init() {
+    if (event_loop.epoll_fd >= 0) return 0;
+
+    event_loop.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    event_loop.shutdown_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (event_loop.epoll_fd < 0 || event_loop.shutdown_fd < 0) {
+        perror("event loop");
+        return -1;
+    }
+    for (int i = 0; i < EVENT_LOOP_MAX_SOURCES; i++) {
+        event_loop.sources[i].fd = -1;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = EVENT_LOOP_SHUTDOWN };
+    return epoll_ctl(event_loop.epoll_fd, EPOLL_CTL_ADD, event_loop.shutdown_fd, &ev);
+}
+
+// handler runs on the event loop thread whenever fd has any of events pending
+extern int event_loop_add_fd(int fd, uint32_t events, EventHandler handler, void *data) {
+    if (event_loop_init() < 0) return -1;
+
+    pthread_mutex_lock(&event_loop.lock);
+    EventSource *source = NULL;
+    for (int i = 0; i < EVENT_LOOP_MAX_SOURCES; i++) {
+        if (event_loop.sources[i].fd < 0) {
+            source = &event_loop.sources[i];
+            break;
+        }
+    }
+    if (source == NULL) {
+        pthread_mutex_unlock(&event_loop.lock);
+        fprintf(stderr, "Too many event loop sources\n");
+        return -1;
+    }
+    source->fd = fd;
+    source->handler = handler;
+    source->data = data;
+
+    struct epoll_event ev = { .events = events, .data.ptr = source };
+    int result = epoll_ctl(event_loop.epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    if (result < 0) {
+        perror("epoll_ctl");
+        source->fd = -1;
+    }
+    pthread_mutex_unlock(&event_loop.lock);
+    return result;
+}
+
+extern void event_loop_remove_fd(int fd) {
+    pthread_mutex_lock(&event_loop.lock);
+    for (int i = 0; i < EVENT_LOOP_MAX_SOURCES; i++) {
+        EventSource *source = &event_loop.sources[i];
+        if (source->fd == fd) {
+            epoll_ctl(event_loop.epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+            source->fd = -1;
+        }
+    }
+    pthread_mutex_unlock(&event_loop.lock);
+}
+
+// Reads the wayland socket only through prepare_read/read_events so that
+// other threads may still flush requests, then dispatches on this thread.
+static void *event_loop_thread(void *arg) {
+    struct wl_display *display = event_loop.display;
+    struct epoll_event events[EVENT_LOOP_MAX_SOURCES + 2];
+
+    while (event_loop.running) {
+        if (display) {
+            while (wl_display_prepare_read(display) != 0) {
+                wl_display_dispatch_pending(display);
+            }
+            wl_display_flush(display);
+        }
+
+        int count = epoll_wait(event_loop.epoll_fd, events,
+                               EVENT_LOOP_MAX_SOURCES + 2, -1);
+        if (count < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            if (display) wl_display_cancel_read(display);
+            break;
+        }
+
+        bool display_readable = false;
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.ptr == EVENT_LOOP_DISPLAY) display_readable = true;
+        }
+        if (display) {
+            if (display_readable) {
+                if (wl_display_read_events(display) < 0) {
+                    fprintf(stderr, "Error in updating cursor position has occured \n");
+                    break;
+                }
+            } else {
+                wl_display_cancel_read(display);
+            }
+            wl_display_dispatch_pending(display);
+        }
+
+        for (int i = 0; i < count; i++) {
+            void *ptr = events[i].data.ptr;
+            if (ptr == EVENT_LOOP_DISPLAY) continue;
+            if (ptr == EVENT_LOOP_SHUTDOWN) {
+                event_loop.running = false;
+                continue;
+            }
+            EventSource *source = ptr;
+            if (source->fd < 0) continue;
+            source->handler(source->data, events[i].events);
+        }
+    }
+    return NULL;
+}
+
+// display may be NULL when only the key readers are needed
+extern int start_event_loop(struct wl_display *display) {
+    if (event_loop_init() < 0) return -1;
+    if (event_loop.running) return 0;
+
+    event_loop.display = display;
+    if (display) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = EVENT_LOOP_DISPLAY };
+        epoll_ctl(event_loop.epoll_fd, EPOLL_CTL_ADD, wl_display_get_fd(display), &ev);
+    }
+    event_loop.running = true;
+    // the thread starts with every signal blocked, so the host's SIGINT and
+    // SIGTERM handlers keep running on the host's threads; shutdown goes
+    // through stop_event_loop and never needs a signal
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    int result = pthread_create(&event_loop.thread, NULL, event_loop_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (result != 0) {
+        fprintf(stderr, "Failed to start event loop thread\n");
+        event_loop.running = false;
+        return -1;
+    }
+    return 0;
+}
+
+// wakes the loop through its eventfd and waits for it, so teardown never
+// races with a dispatch in progress
+extern void stop_event_loop() {
+    if (event_loop.epoll_fd < 0) return;
+
+    if (event_loop.running) {
+        uint64_t one = 1;
+        write(event_loop.shutdown_fd, &one, sizeof(one));
+        pthread_join(event_loop.thread, NULL);
+        event_loop.running = false;
+    }
+    for (int i = 0; i < EVENT_LOOP_MAX_SOURCES; i++) {
+        if (event_loop.sources[i].fd >= 0) event_loop_remove_fd(event_loop.sources[i].fd);
+    }
+    close(event_loop.shutdown_fd);
+    close(event_loop.epoll_fd);
+    event_loop.shutdown_fd = -1;
+    event_loop.epoll_fd = -1;
+    event_loop.display = NULL;
+}
+
+#endif
@@ -5,6 +5,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include <time.h>
 #include <assert.h>
 #include <errno.h>
@@ -12,6 +19,9 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include "relative_move.h"
+#include "raster.h"
+#include "hooks.h"
+#include "latency.h"
 
 #include <wayland-client-protocol.h>
 #include <wayland-client.h>
@@ -20,6 +30,8 @@
 #include "wlr-layer-shell-unstable-v1.h"
 #include "wlr-virtual-pointer-unstable-v1.h"
 #include "viewporter.h"
+#include "xdg-output-unstable-v1.h"
+#include "presentation-time.h"
 
 
 
@@ -53,34 +65,177 @@ bool running = true;
 struct wl_display *display = NULL;
 struct wl_registry *registry = NULL;
 struct wl_compositor *compositor = NULL;
-struct wl_surface *surface = NULL;
 struct zwlr_layer_shell_v1 *layer_shell = NULL;
 struct wp_viewporter *viewporter = NULL;
 struct wp_single_pixel_buffer_manager_v1 *single_pixel_buffer_manager = NULL;
 struct zwlr_virtual_pointer_manager_v1 *virtual_pointer_manager = NULL;
-
-// output
-// using NULL for focused output
-struct wl_output *output = NULL;
-struct zwlr_layer_surface_v1 *layer_surface = NULL;
-struct wp_viewport *viewport = NULL;
-struct wl_callback *frame_callback = NULL;
-int surface_width = 0;
-int surface_height = 0;
+struct zxdg_output_manager_v1 *xdg_output_manager = NULL;
+struct wp_presentation *presentation = NULL;
+clockid_t presentation_clock = CLOCK_MONOTONIC;
+
+// outputs
+// every wl_output gets its own overlay, so the pointer is seen on all of them
+#define MAX_OUTPUTS 8
+
+// The animation draws into one shm pool per output holding two ARGB
+// buffers. The pool is kept across enters and frames and only grows on
+// resize; a buffer is drawn into again only after its release event.
+// A resize while the compositor still holds a buffer retires the whole
+// pool instead, it is freed once its last buffer comes back.
+#define OVERLAY_BUFFERS 2
+
+typedef struct {
+  struct wl_buffer *buffer;
+  uint32_t *pixels;
+  bool busy;  // attached, compositor has not released it yet
+  PixelRect dirty;  // what was drawn into it last time
+} OverlayBuffer;
+
+typedef struct ShmPool {
+  int fd;
+  uint8_t *data;
+  size_t size;
+  struct wl_shm_pool *pool;
+  int width, height;
+  OverlayBuffer buffers[OVERLAY_BUFFERS];
+  struct ShmPool *retired;  // older pools with buffers not yet released
+} ShmPool;
+
+typedef struct {
+  struct wl_output *wl_output;  // NULL for the focused-output fallback
+  struct zxdg_output_v1 *xdg_output;
+  uint32_t global_name;         // registry name, matched in global_remove
+  // as reported by wl_output, used when there is no xdg-output
+  int32_t x, y;
+  int32_t mode_width, mode_height;
+  int32_t transform;
+  int32_t scale;
+  // as reported by xdg-output
+  int32_t logical_x, logical_y;
+  int32_t logical_width, logical_height;
+  bool has_logical;
+  // region in the global compositor space, recomputed on every done
+  int global_x, global_y;
+  int global_width, global_height;
+  // overlay
+  struct wl_surface *surface;
+  struct zwlr_layer_surface_v1 *layer_surface;
+  struct wp_viewport *viewport;
+  int surface_width, surface_height;
+  bool configured;
+  // animation
+  ShmPool shm_pool;
+  struct wl_callback *frame_callback;
+  PixelRect shown;  // drawn area of the last committed frame
+  bool redraw_pending;  // a frame was due while both buffers were busy
+  int drawn_x, drawn_y, drawn_radius;  // circle in the last committed frame
+  // presentation feedback, drives the animation clock
+  struct wp_presentation_feedback *feedback;
+  int64_t last_present_ns;  // in presentation_clock
+  uint32_t refresh_ns;
+} Output;
+
+Output *outputs[MAX_OUTPUTS];
+int output_count = 0;
+bool overlays_created = false;
+
+// bounding box of all outputs in the global compositor space
+struct {
+  int x, y;
+  int width, height;
+} virtual_screen;
+
+// Screen geometry for other threads, e.g. the tablet mapping and
+// GetSystemMetrics. Republished only when outputs change, with the same
+// seqlock scheme as cursor_state.
+typedef struct {
+  int primary_width;   // the output at the origin, or the first one
+  int primary_height;
+  int virtual_x;
+  int virtual_y;
+  int virtual_width;
+  int virtual_height;
+  int monitors;
+} ScreenMetrics;
+
+struct {
+  _Atomic uint64_t sequence;
+  _Atomic int values[sizeof(ScreenMetrics) / sizeof(int)];
+} screen_metrics;
+
+// the overlay the pointer is on, which the animation draws to
+Output *cursor_output = NULL;
 
 // seat
 struct wl_seat *seat = NULL;
+uint32_t seat_name = 0;
 struct wl_pointer *pointer = NULL;
 struct zwlr_virtual_pointer_v1 *virtual_pointer = NULL;
-// set it in pointer_handle_enter
+// surface-local position on cursor_output, set in pointer_handle_enter;
+// only read these on the wayland thread, other threads go through
+// read_cursor_sample, which holds the global position. Only
+// cursor_output draws the circle, the other overlays stay empty.
 int cursor_x;
 int cursor_y;
 extern int cursor_x;
 extern int cursor_y;
 
+// Cursor position as published to other threads. A seqlock: the wayland
+// thread is the only writer and makes sequence odd while it updates the
+// fields, so readers retry instead of seeing a new x with an old y.
+typedef struct {
+  int x;
+  int y;
+  uint32_t time;      // ms, the wayland event timestamp
+  uint64_t sequence;  // increments with every published position
+} CursorSample;
+
+struct {
+  _Alignas(64) _Atomic uint64_t sequence;
+  _Atomic int x;
+  _Atomic int y;
+  _Atomic uint32_t time;
+  // bumped after every publish; waiters sleep on it with FUTEX_WAIT
+  _Alignas(64) _Atomic uint32_t wake;
+  _Atomic int waiters;
+} cursor_state;
+
+// Every published position also goes into a ring, newest at head - 1.
+// The wayland thread is the only writer; each slot carries its own
+// sequence so readers can detect a slot overwritten while they copy it.
+#define MOTION_HISTORY_SIZE 256
+
+typedef struct {
+  _Atomic uint64_t sequence;  // 2 * index + 2 once written, odd while writing
+  _Atomic int x;
+  _Atomic int y;
+  _Atomic uint32_t time;
+} MotionSlot;
+
+struct {
+  _Alignas(64) _Atomic uint64_t head;
+  MotionSlot slots[MOTION_HISTORY_SIZE];
+} motion_history;
+
+#define MAX_CURSOR_CALLBACKS 8
+
+typedef void (*CursorCallback)(const CursorSample *sample, void *user_data);
+
+// called on the wayland thread for every published position
+struct {
+  pthread_mutex_t lock;
+  _Atomic int count;
+  _Atomic(CursorCallback) callbacks[MAX_CURSOR_CALLBACKS];
+  void *user_data[MAX_CURSOR_CALLBACKS];
+  _Atomic bool running[MAX_CURSOR_CALLBACKS];  // set by the wayland thread around each call
+  bool retiring[MAX_CURSOR_CALLBACKS];  // unregistered, not reusable until the call ends
+} cursor_callbacks = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+// true on the wayland thread while it runs the callbacks
+static _Thread_local bool in_cursor_callbacks = false;
+
 // shm
 struct wl_shm *shm = NULL;
-struct wl_buffer *shm_buffer = NULL;
 
 
 int64_t start_ms = 0;
@@ -95,6 +250,178 @@ static int64_t now_ms(void) {
   return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
+static void publish_cursor(int x, int y, uint32_t time) {
+  uint64_t seq = atomic_load_explicit(&cursor_state.sequence, memory_order_relaxed);
+  atomic_store_explicit(&cursor_state.sequence, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&cursor_state.x, x, memory_order_relaxed);
+  atomic_store_explicit(&cursor_state.y, y, memory_order_relaxed);
+  atomic_store_explicit(&cursor_state.time, time, memory_order_relaxed);
+  atomic_store_explicit(&cursor_state.sequence, seq + 2, memory_order_release);
+
+  uint64_t index = atomic_load_explicit(&motion_history.head, memory_order_relaxed);
+  MotionSlot *slot = &motion_history.slots[index % MOTION_HISTORY_SIZE];
+  atomic_store_explicit(&slot->sequence, 2 * index + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&slot->x, x, memory_order_relaxed);
+  atomic_store_explicit(&slot->y, y, memory_order_relaxed);
+  atomic_store_explicit(&slot->time, time, memory_order_relaxed);
+  atomic_store_explicit(&slot->sequence, 2 * index + 2, memory_order_release);
+  atomic_store_explicit(&motion_history.head, index + 1, memory_order_release);
+
+  atomic_fetch_add(&cursor_state.wake, 1);
+  if (atomic_load(&cursor_state.waiters) > 0) {
+    syscall(SYS_futex, &cursor_state.wake, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+  }
+
+  int count = atomic_load_explicit(&cursor_callbacks.count, memory_order_acquire);
+  if (count > 0) {
+    CursorSample sample = { .x = x, .y = y, .time = time, .sequence = seq / 2 + 1 };
+    in_cursor_callbacks = true;
+    for (int i = 0; i < count; i++) {
+      // running goes up before the callback is read (both seq_cst), so an
+      // unregister either makes us see NULL or sees running and waits
+      atomic_store(&cursor_callbacks.running[i], true);
+      CursorCallback callback = atomic_load(&cursor_callbacks.callbacks[i]);
+      if (callback != NULL) {
+        callback(&sample, cursor_callbacks.user_data[i]);
+      }
+      atomic_store_explicit(&cursor_callbacks.running[i], false, memory_order_release);
+    }
+    in_cursor_callbacks = false;
+  }
+}
+
+static void read_cursor_sample(CursorSample *sample) {
+  uint64_t before, after;
+  do {
+    before = atomic_load_explicit(&cursor_state.sequence, memory_order_acquire);
+    sample->x = atomic_load_explicit(&cursor_state.x, memory_order_relaxed);
+    sample->y = atomic_load_explicit(&cursor_state.y, memory_order_relaxed);
+    sample->time = atomic_load_explicit(&cursor_state.time, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    after = atomic_load_explicit(&cursor_state.sequence, memory_order_relaxed);
+  } while ((before & 1) || before != after);
+  sample->sequence = before / 2;
+}
+
+// Copies up to max positions from the motion history into out, newest
+// first, and returns how many were copied. Never blocks the writer: the
+// copy stops at the first slot the wayland thread has already reused.
+static int read_motion_history(CursorSample *out, int max) {
+  uint64_t head = atomic_load_explicit(&motion_history.head, memory_order_acquire);
+  int count = 0;
+  while (count < max && count < MOTION_HISTORY_SIZE && (uint64_t)count < head) {
+    uint64_t index = head - 1 - count;
+    MotionSlot *slot = &motion_history.slots[index % MOTION_HISTORY_SIZE];
+    uint64_t before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    out[count].x = atomic_load_explicit(&slot->x, memory_order_relaxed);
+    out[count].y = atomic_load_explicit(&slot->y, memory_order_relaxed);
+    out[count].time = atomic_load_explicit(&slot->time, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t after = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+    if (before != 2 * index + 2 || after != before) break;
+    out[count].sequence = index + 1;
+    count++;
+  }
+  return count;
+}
+
+// Sleeps until a position with a sequence number above after_sequence is
+// published or timeout_ms passes (negative waits forever). Returns false on timeout.
+static bool wait_cursor_sample(uint64_t after_sequence, int64_t timeout_ms, CursorSample *sample) {
+  int64_t deadline = timeout_ms >= 0 ? now_ms() + timeout_ms : 0;
+  bool moved = false;
+
+  atomic_fetch_add(&cursor_state.waiters, 1);
+  for (;;) {
+    uint32_t wake = atomic_load(&cursor_state.wake);
+    read_cursor_sample(sample);
+    if (sample->sequence > after_sequence) {
+      moved = true;
+      break;
+    }
+
+    struct timespec timeout, *timeout_ptr = NULL;
+    if (timeout_ms >= 0) {
+      int64_t remaining = deadline - now_ms();
+      if (remaining <= 0) break;
+      timeout.tv_sec = remaining / 1000;
+      timeout.tv_nsec = (remaining % 1000) * 1000000;
+      timeout_ptr = &timeout;
+    }
+    syscall(SYS_futex, &cursor_state.wake, FUTEX_WAIT_PRIVATE, wake, timeout_ptr, NULL, 0);
+  }
+  atomic_fetch_sub(&cursor_state.waiters, 1);
+  return moved;
+}
+
+// Returns a handle for unregister_cursor_callback, or -1 when all slots are taken.
+static int register_cursor_callback(CursorCallback callback, void *user_data) {
+  int handle = -1;
+  pthread_mutex_lock(&cursor_callbacks.lock);
+  int count = atomic_load(&cursor_callbacks.count);
+  for (int i = 0; i < count; i++) {
+    if (atomic_load(&cursor_callbacks.callbacks[i]) == NULL && !cursor_callbacks.retiring[i]) {
+      handle = i;
+      break;
+    }
+  }
+  if (handle < 0 && count < MAX_CURSOR_CALLBACKS) {
+    handle = count;
+  }
+  if (handle >= 0) {
+    cursor_callbacks.user_data[handle] = user_data;
+    atomic_store_explicit(&cursor_callbacks.callbacks[handle], callback, memory_order_release);
+    if (handle == count) {
+      atomic_store_explicit(&cursor_callbacks.count, count + 1, memory_order_release);
+    }
+  }
+  pthread_mutex_unlock(&cursor_callbacks.lock);
+  return handle;
+}
+
+// Returns once the callback is no longer running, so its user_data may be
+// freed or changed right after. A callback may unregister itself; that
+// returns at once, the current call still finishes.
+static void unregister_cursor_callback(int handle) {
+  if (handle < 0 || handle >= MAX_CURSOR_CALLBACKS) return;
+  pthread_mutex_lock(&cursor_callbacks.lock);
+  if (atomic_load(&cursor_callbacks.callbacks[handle]) == NULL) {
+    pthread_mutex_unlock(&cursor_callbacks.lock);
+    return;
+  }
+  atomic_store(&cursor_callbacks.callbacks[handle], NULL);
+  cursor_callbacks.retiring[handle] = true;
+  pthread_mutex_unlock(&cursor_callbacks.lock);
+
+  // callbacks are short, waiting out the one in flight beats a futex here
+  if (!in_cursor_callbacks) {
+    while (atomic_load(&cursor_callbacks.running[handle])) {
+      sched_yield();
+    }
+  }
+
+  pthread_mutex_lock(&cursor_callbacks.lock);
+  cursor_callbacks.retiring[handle] = false;
+  pthread_mutex_unlock(&cursor_callbacks.lock);
+}
+
+// the overlay covers its whole output, so surface coordinates are offset
+// by the output's cached origin in the global compositor space
+static void surface_to_global(int *x, int *y) {
+  if (cursor_output != NULL) {
+    *x += cursor_output->global_x;
+    *y += cursor_output->global_y;
+  }
+}
+
+static void publish_cursor_local(int x, int y, uint32_t time) {
+  surface_to_global(&x, &y);
+  publish_cursor(x, y, time);
+  hook_mouse_event(WM_MOUSEMOVE, x, y, 0, time);
+}
+
 static void randname(char *buf)
 {
   struct timespec ts;
@@ -139,24 +466,270 @@ int allocate_shm_file(size_t size)
 }
 
 
-static void update_pixels(uint32_t *pixels);
+static void shm_pool_destroy_buffers(ShmPool *pool) {
+  for (int i = 0; i < OVERLAY_BUFFERS; i++) {
+    if (pool->buffers[i].buffer != NULL) {
+      wl_buffer_destroy(pool->buffers[i].buffer);
+    }
+    pool->buffers[i].buffer = NULL;
+    pool->buffers[i].pixels = NULL;
+    pool->buffers[i].busy = false;
+  }
+}
+
+static void shm_pool_finish(ShmPool *pool) {
+  while (pool->retired != NULL) {
+    ShmPool *old = pool->retired;
+    pool->retired = old->retired;
+    old->retired = NULL;
+    shm_pool_finish(old);
+    free(old);
+  }
+  shm_pool_destroy_buffers(pool);
+  if (pool->pool != NULL) {
+    wl_shm_pool_destroy(pool->pool);
+    munmap(pool->data, pool->size);
+    close(pool->fd);
+  }
+  memset(pool, 0, sizeof(*pool));
+}
+
+static void overlay_buffer_handle_release(void *data, struct wl_buffer *wl_buffer);
+
+static bool shm_pool_busy(const ShmPool *pool) {
+  for (int i = 0; i < OVERLAY_BUFFERS; i++) {
+    if (pool->buffers[i].buffer != NULL && pool->buffers[i].busy) return true;
+  }
+  return false;
+}
+
+// Moves the pool's storage aside so new buffers get a fresh pool. Released
+// buffers go now, the busy ones when the compositor lets go of them.
+static int shm_pool_retire(ShmPool *pool) {
+  ShmPool *old = malloc(sizeof(*old));
+  if (old == NULL) return -1;
+  *old = *pool;
+  for (int i = 0; i < OVERLAY_BUFFERS; i++) {
+    if (old->buffers[i].buffer != NULL && !old->buffers[i].busy) {
+      wl_buffer_destroy(old->buffers[i].buffer);
+      old->buffers[i].buffer = NULL;
+    }
+  }
+  memset(pool, 0, sizeof(*pool));
+  pool->retired = old;
+  return 0;
+}
+
+static void shm_pool_released(ShmPool *pool, struct wl_buffer *wl_buffer) {
+  for (int i = 0; i < OVERLAY_BUFFERS; i++) {
+    if (pool->buffers[i].buffer == wl_buffer) {
+      pool->buffers[i].busy = false;
+      return;
+    }
+  }
+  for (ShmPool **link = &pool->retired; *link != NULL; link = &(*link)->retired) {
+    ShmPool *old = *link;
+    bool found = false, left = false;
+    for (int i = 0; i < OVERLAY_BUFFERS; i++) {
+      if (old->buffers[i].buffer == wl_buffer) {
+        wl_buffer_destroy(wl_buffer);
+        old->buffers[i].buffer = NULL;
+        found = true;
+      } else if (old->buffers[i].buffer != NULL) {
+        left = true;
+      }
+    }
+    if (!found) continue;
+    if (!left) {
+      *link = old->retired;
+      old->retired = NULL;
+      shm_pool_finish(old);
+      free(old);
+    }
+    return;
+  }
+}
+
+static const struct wl_buffer_listener overlay_buffer_listener = {
+  .release = overlay_buffer_handle_release,
+};
+
+// (Re)creates the two buffers when the surface size changed. The backing
+// file is only ever enlarged, wl_shm_pool cannot shrink. Returns 1 when
+// the buffers are new, 0 when they were kept, -1 on failure.
+static int shm_pool_prepare(ShmPool *pool, void *owner, int width, int height) {
+  if (width <= 0 || height <= 0) return -1;
+  if (pool->pool != NULL && pool->width == width && pool->height == height) return 0;
+
+  const int stride = width * 4;
+  const size_t buffer_size = (size_t)stride * height;
+  const size_t needed = buffer_size * OVERLAY_BUFFERS;
+
+  if (shm_pool_busy(pool)) {
+    // the compositor may still read the old pixels, leave them alone
+    if (shm_pool_retire(pool) < 0) return -1;
+  } else {
+    shm_pool_destroy_buffers(pool);
+  }
+  if (pool->pool == NULL) {
+    pool->fd = allocate_shm_file(needed);
+    if (pool->fd < 0) return -1;
+    pool->data = mmap(NULL, needed, PROT_READ | PROT_WRITE, MAP_SHARED, pool->fd, 0);
+    if (pool->data == MAP_FAILED) {
+      close(pool->fd);
+      pool->data = NULL;
+      return -1;
+    }
+    pool->size = needed;
+    pool->pool = wl_shm_create_pool(shm, pool->fd, needed);
+  } else if (needed > pool->size) {
+    int ret;
+    do {
+      ret = ftruncate(pool->fd, needed);
+    } while (ret < 0 && errno == EINTR);
+    uint8_t *data = ret < 0 ? MAP_FAILED : mmap(NULL, needed, PROT_READ | PROT_WRITE, MAP_SHARED, pool->fd, 0);
+    if (data == MAP_FAILED) {
+      shm_pool_finish(pool);
+      return -1;
+    }
+    munmap(pool->data, pool->size);
+    pool->data = data;
+    pool->size = needed;
+    wl_shm_pool_resize(pool->pool, needed);
+  }
+
+  pool->width = width;
+  pool->height = height;
+  memset(pool->data, 0, needed);
+  for (int i = 0; i < OVERLAY_BUFFERS; i++) {
+    OverlayBuffer *buffer = &pool->buffers[i];
+    buffer->buffer = wl_shm_pool_create_buffer(pool->pool, buffer_size * i, width, height, stride, WL_SHM_FORMAT_ARGB8888);
+    buffer->pixels = (uint32_t *)(pool->data + buffer_size * i);
+    buffer->busy = false;
+    buffer->dirty = (PixelRect){ 0, 0, 0, 0 };
+    wl_buffer_add_listener(buffer->buffer, &overlay_buffer_listener, owner);
+  }
+  return 1;
+}
+
+static OverlayBuffer *shm_pool_acquire(ShmPool *pool) {
+  for (int i = 0; i < OVERLAY_BUFFERS; i++) {
+    if (pool->buffers[i].buffer != NULL && !pool->buffers[i].busy) {
+      return &pool->buffers[i];
+    }
+  }
+  return NULL;
+}
+
+static void update_pixels(Output *o);
 
 static void frame_callback_handle_done(void *data, struct wl_callback *callback, uint32_t time) {
-  assert(callback == frame_callback);
+  Output *o = data;
+  assert(callback == o->frame_callback);
   wl_callback_destroy(callback);
-  frame_callback = NULL;
-  update_pixels((uint32_t *)data);
+  o->frame_callback = NULL;
+  update_pixels(o);
 }
 
 static const struct wl_callback_listener frame_callback_listener = {
   .done = frame_callback_handle_done,
 };
 
-static void update_pixels(uint32_t *pixels) {
-  int64_t delta = now_ms() - start_ms;
-  double progress = (double)delta / delay_ms;
-  if (progress >= 1) {
-    //running = false;
+static void overlay_buffer_handle_release(void *data, struct wl_buffer *wl_buffer) {
+  Output *o = data;
+  shm_pool_released(&o->shm_pool, wl_buffer);
+  if (o->redraw_pending) {
+    o->redraw_pending = false;
+    update_pixels(o);
+  }
+}
+
+static void presentation_handle_clock_id(void *data, struct wp_presentation *wp_presentation, uint32_t clk_id) {
+  presentation_clock = (clockid_t)clk_id;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+  .clock_id = presentation_handle_clock_id,
+};
+
+static void feedback_handle_sync_output(void *data, struct wp_presentation_feedback *feedback, struct wl_output *wl_output) {
+}
+
+static void feedback_handle_presented(void *data, struct wp_presentation_feedback *feedback,
+    uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh,
+    uint32_t seq_hi, uint32_t seq_lo, uint32_t flags) {
+  Output *o = data;
+  int64_t seconds = ((int64_t)tv_sec_hi << 32) | tv_sec_lo;
+  o->last_present_ns = seconds * 1000000000 + tv_nsec;
+  o->refresh_ns = refresh;
+  wp_presentation_feedback_destroy(feedback);
+  o->feedback = NULL;
+}
+
+static void feedback_handle_discarded(void *data, struct wp_presentation_feedback *feedback) {
+  Output *o = data;
+  wp_presentation_feedback_destroy(feedback);
+  o->feedback = NULL;
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+  .sync_output = feedback_handle_sync_output,
+  .presented = feedback_handle_presented,
+  .discarded = feedback_handle_discarded,
+};
+
+// When the frame being drawn now will reach the screen, in now_ms() time:
+// the last presentation timestamp advanced by whole refresh periods past
+// now. Without presentation feedback (or a fixed refresh) it is just now.
+static int64_t predicted_present_ms(Output *o) {
+  int64_t now = now_ms();
+  if (o->last_present_ns == 0 || o->refresh_ns == 0) return now;
+
+  struct timespec ts;
+  if (clock_gettime(presentation_clock, &ts) != 0) return now;
+  int64_t clock_now = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  int64_t periods = (clock_now - o->last_present_ns) / o->refresh_ns + 1;
+  if (periods < 1) periods = 1;
+  int64_t predicted = o->last_present_ns + periods * (int64_t)o->refresh_ns;
+  return now + (predicted - clock_now) / 1000000;
+}
+
+// Commits an empty frame on an overlay the pointer is no longer on. Only
+// the circle it still shows is cleared and damaged; after that it idles
+// without a frame callback until the pointer comes back.
+static void clear_overlay(Output *o) {
+  if (rect_empty(o->shown)) return;
+  OverlayBuffer *buffer = shm_pool_acquire(&o->shm_pool);
+  if (buffer == NULL) {
+    o->redraw_pending = true;
+    return;
+  }
+  clear_rect(buffer->pixels, o->shm_pool.width, buffer->dirty);
+  buffer->dirty = (PixelRect){ 0, 0, 0, 0 };
+  PixelRect damage = o->shown;
+  o->shown = buffer->dirty;
+  o->drawn_radius = -1;
+
+  wl_surface_attach(o->surface, buffer->buffer, 0, 0);
+  buffer->busy = true;
+  wl_surface_damage_buffer(o->surface, damage.x0, damage.y0,
+                           damage.x1 - damage.x0, damage.y1 - damage.y0);
+  wl_surface_commit(o->surface);
+}
+
+static void update_pixels(Output *o) {
+  if (o->surface == NULL || no_animation) return;
+  // cursor_x/cursor_y are local to cursor_output, anywhere else they are
+  // another monitor's coordinates
+  if (o != cursor_output) {
+    clear_overlay(o);
+    return;
+  }
+  const int surface_width = o->surface_width, surface_height = o->surface_height;
+
+  double progress = (double)(predicted_present_ms(o) - start_ms) / delay_ms;
+  if (progress > 1) {
+    progress = 1;
   }
 
   int radius = (surface_height < surface_width ? surface_height : surface_width)/20; // Starting radius
@@ -165,49 +738,81 @@ static void update_pixels(uint32_t *pixels) {
 
   radius = radius * progress; // Animate the radius
 
-  int center_x = cursor_x;
-  int center_y = cursor_y;
-
-  // Calculate bounding box to optimize
-  int min_x = center_x - radius;
-  int max_x = center_x + radius;
-  int min_y = center_y - radius;
-  int max_y = center_y + radius;
-
-  // Clamp to surface bounds
-  min_x = min_x < 0 ? 0 : min_x;
-  max_x = max_x > surface_width ? surface_width : max_x;
-  min_y = min_y < 0 ? 0 : min_y;
-  max_y = max_y > surface_height ? surface_height : max_y;
-
-  int radius_squared = radius * radius;
-
-  for (int y = min_y; y < max_y; y++) {
-    for (int x = min_x; x < max_x; x++) {
-      int dx = x - center_x;
-      int dy = y - center_y;
-      if (dx*dx + dy*dy <= radius_squared) {
-        pixels[x + (y * surface_width)] = color;
-      }
+  if (radius == o->drawn_radius && cursor_x == o->drawn_x && cursor_y == o->drawn_y &&
+      o->shm_pool.width == surface_width && o->shm_pool.height == surface_height) {
+    if (progress < 1) {
+      // nothing new to show yet, only ask to be woken for the next frame
+      o->frame_callback = wl_surface_frame(o->surface);
+      wl_callback_add_listener(o->frame_callback, &frame_callback_listener, o);
+      wl_surface_commit(o->surface);
     }
+    // finished and the cursor is still: idle until the next motion
+    return;
+  }
+
+  int recreated = shm_pool_prepare(&o->shm_pool, o, o->surface_width, o->surface_height);
+  if (recreated < 0) {
+    fprintf(stderr, "Failed to allocate the overlay buffers\n");
+    return;
   }
+  OverlayBuffer *buffer = shm_pool_acquire(&o->shm_pool);
+  if (buffer == NULL) {
+    // both still with the compositor, draw once one comes back
+    o->redraw_pending = true;
+    return;
+  }
+  uint32_t *pixels = buffer->pixels;
 
-  wl_surface_attach(surface, shm_buffer, 0, 0);
-  wp_viewport_set_destination(viewport, surface_width, surface_height);
+  // only the area this buffer was drawn into two frames ago needs clearing
+  clear_rect(pixels, surface_width, buffer->dirty);
+  buffer->dirty = fill_circle(pixels, surface_width, surface_height,
+                              cursor_x, cursor_y, radius, color);
 
-  frame_callback = wl_surface_frame(surface);
-  wl_callback_add_listener(frame_callback, &frame_callback_listener, pixels);
-  wl_surface_damage(surface, 0, 0, INT32_MAX, INT32_MAX);
-  wl_surface_commit(surface);
+  // what changed on screen: the last frame's circle and this one
+  PixelRect damage = rect_union(o->shown, buffer->dirty);
+  if (recreated) {
+    damage = (PixelRect){ 0, 0, surface_width, surface_height };
+  }
+  o->shown = buffer->dirty;
+  o->drawn_x = cursor_x;
+  o->drawn_y = cursor_y;
+  o->drawn_radius = radius;
+
+  wl_surface_attach(o->surface, buffer->buffer, 0, 0);
+  buffer->busy = true;
+  wp_viewport_set_destination(o->viewport, surface_width, surface_height);
+
+  o->frame_callback = wl_surface_frame(o->surface);
+  wl_callback_add_listener(o->frame_callback, &frame_callback_listener, o);
+  if (!rect_empty(damage)) {
+    wl_surface_damage_buffer(o->surface, damage.x0, damage.y0,
+                             damage.x1 - damage.x0, damage.y1 - damage.y0);
+  }
+  if (presentation != NULL && o->feedback == NULL) {
+    o->feedback = wp_presentation_feedback(presentation, o->surface);
+    wp_presentation_feedback_add_listener(o->feedback, &feedback_listener, o);
+  }
+  wl_surface_commit(o->surface);
 }
 
 
 
 
-static void pointer_handle_enter(void *data, struct wl_pointer *wl_pointer, uint32_t serial, struct wl_surface *surface, wl_fixed_t surface_x, wl_fixed_t surface_y) {
+static void pointer_handle_enter(void *data, struct wl_pointer *wl_pointer, uint32_t serial, struct wl_surface *entered, wl_fixed_t surface_x, wl_fixed_t surface_y) {
+
+  Output *previous = cursor_output;
+  cursor_output = NULL;
+  for (int i = 0; i < output_count; i++) {
+    if (outputs[i]->surface == entered) {
+      cursor_output = outputs[i];
+      break;
+    }
+  }
 
   cursor_x = wl_fixed_to_int(surface_x);
   cursor_y = wl_fixed_to_int(surface_y);
+  // enter carries no timestamp, compositors use the monotonic clock in ms
+  publish_cursor_local(cursor_x, cursor_y, (uint32_t)now_ms());
 
   //printf("%d %d enter\n", cursor_x, cursor_y);
 
@@ -216,47 +821,100 @@ static void pointer_handle_enter(void *data, struct wl_pointer *wl_pointer, uint
     return;
   }
 
-  const int width = surface_width, height = surface_height;
-  const int stride = width * 4;
-  const int shm_pool_size = height * stride * 2;
-
-  int fd = allocate_shm_file(shm_pool_size);
-  uint8_t *pool_data = mmap(NULL, shm_pool_size,
-      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-  struct wl_shm_pool *pool = wl_shm_create_pool(shm, fd, shm_pool_size);
-  int index = 0;
-  int offset = height * stride * index;
-
-  shm_buffer = wl_shm_pool_create_buffer(pool, offset, width, height, stride, WL_SHM_FORMAT_ARGB8888);
-
-  wl_shm_pool_destroy(pool);
-
-  uint32_t *pixels = (uint32_t *)&pool_data[offset];
-
-  update_pixels(pixels);
+  // the overlay left behind drops its circle, a pending frame does it otherwise
+  if (previous != NULL && previous != cursor_output && previous->frame_callback == NULL) {
+    update_pixels(previous);
+  }
+  // keep the running animation if a frame is already on its way
+  if (cursor_output != NULL && cursor_output->frame_callback == NULL) {
+    update_pixels(cursor_output);
+  }
 }
 
 static void pointer_handle_leave(void *data, struct wl_pointer *wl_pointer,
     uint32_t serial, struct wl_surface *surface) {
  // running = false;
+  if (cursor_output == NULL || cursor_output->surface != surface) return;
+  Output *left = cursor_output;
+  cursor_output = NULL;
+  if (left->frame_callback == NULL) {
+    update_pixels(left);
+  }
 }
 
 static void pointer_handle_motion(void *data, struct wl_pointer *wl_pointer,
     uint32_t time, wl_fixed_t surface_x, wl_fixed_t surface_y) {
   cursor_x = wl_fixed_to_int(surface_x);
   cursor_y = wl_fixed_to_int(surface_y);
+  latency_observe_motion(time);
+  publish_cursor_local(cursor_x, cursor_y, time);
   //printf("%d %d move \n", cursor_x, cursor_y);
   running = false;
+
+  // a finished animation sleeps until the circle has to follow the cursor
+  if (cursor_output != NULL && cursor_output->frame_callback == NULL) {
+    update_pixels(cursor_output);
+  }
 }
 
 static void pointer_handle_button(void *data, struct wl_pointer *wl_pointer,
     uint32_t serial, uint32_t time, uint32_t button, uint32_t state) {
   //running = false;
+  bool down = state == WL_POINTER_BUTTON_STATE_PRESSED;
+  if (!atomic_load(&key_state_pointer_from_libinput)) {
+    latency_observed_ms(time);
+    key_state_set(button, down);
+  }
+  WPARAM message;
+  DWORD mouse_data = 0;
+  switch (button) {
+    case BTN_LEFT:   message = down ? WM_LBUTTONDOWN : WM_LBUTTONUP; break;
+    case BTN_RIGHT:  message = down ? WM_RBUTTONDOWN : WM_RBUTTONUP; break;
+    case BTN_MIDDLE: message = down ? WM_MBUTTONDOWN : WM_MBUTTONUP; break;
+    case BTN_SIDE:
+    case BTN_EXTRA:
+      message = down ? WM_XBUTTONDOWN : WM_XBUTTONUP;
+      mouse_data = (DWORD)(button == BTN_SIDE ? XBUTTON1 : XBUTTON2) << 16;
+      break;
+    default: return;
+  }
+  int x = cursor_x, y = cursor_y;
+  surface_to_global(&x, &y);
+  hook_mouse_event(message, x, y, mouse_data, time);
 }
 
+// one wheel notch is 10 units of axis value on common compositors
+#define AXIS_UNITS_PER_NOTCH 10
+
+// what each axis scrolled short of a whole WHEEL_DELTA unit, carried into
+// the next event so touchpad and high-resolution scrolling add up
+int64_t axis_remainder[2];
+
 static void pointer_handle_axis(void *data, struct wl_pointer *wl_pointer,
     uint32_t time, uint32_t axis, wl_fixed_t value) {
   //running = false;
+  if (axis > WL_POINTER_AXIS_HORIZONTAL_SCROLL) return;
+  const int64_t divisor = AXIS_UNITS_PER_NOTCH * 256;
+  int64_t scaled = (int64_t)value * WHEEL_DELTA + axis_remainder[axis];
+  int delta = (int)(scaled / divisor);
+  axis_remainder[axis] = scaled - (int64_t)delta * divisor;
+  if (delta == 0) return;
+  // wayland scrolls down/right for positive values, windows' wheel is
+  // positive away from the user
+  WPARAM message = WM_MOUSEHWHEEL;
+  int wheel = KEY_STATE_WHEEL_HORIZONTAL;
+  if (axis == WL_POINTER_AXIS_VERTICAL_SCROLL) {
+    message = WM_MOUSEWHEEL;
+    wheel = KEY_STATE_WHEEL_VERTICAL;
+    delta = -delta;
+  }
+  if (!atomic_load(&key_state_pointer_from_libinput)) {
+    latency_observed_ms(time);
+    key_state_add_wheel(wheel, delta);
+  }
+  int x = cursor_x, y = cursor_y;
+  surface_to_global(&x, &y);
+  hook_mouse_event(message, x, y, (DWORD)(uint16_t)(int16_t)delta << 16, time);
 }
 
 static const struct wl_pointer_listener pointer_listener = {
@@ -285,6 +943,318 @@ static const struct wl_seat_listener seat_listener = {
 
 
 
+// Tracking only needs pointer events: the overlay content is a 1x1
+// transparent single-pixel buffer stretched over the output by the
+// viewport, so no shm is mapped and there is nothing to upload. The input
+// region is set explicitly to the whole output and the opaque region is
+// left empty.
+static void overlay_attach_input_only(Output *o) {
+  struct wl_buffer *buffer = wp_single_pixel_buffer_manager_v1_create_u32_rgba_buffer(single_pixel_buffer_manager, 0, 0, 0, 0);
+  wl_surface_attach(o->surface, buffer, 0, 0);
+  wp_viewport_set_destination(o->viewport, o->surface_width, o->surface_height);
+
+  struct wl_region *region = wl_compositor_create_region(compositor);
+  wl_region_add(region, 0, 0, o->surface_width, o->surface_height);
+  wl_surface_set_input_region(o->surface, region);
+  wl_region_destroy(region);
+  wl_surface_set_opaque_region(o->surface, NULL);
+
+  wl_surface_damage_buffer(o->surface, 0, 0, 1, 1);
+  wl_surface_commit(o->surface);
+  wl_buffer_destroy(buffer);
+  // the animation buffers, if any, no longer show on screen
+  o->shown = (PixelRect){ 0, 0, 0, 0 };
+}
+
+static void layer_surface_handle_configure(void *data, struct zwlr_layer_surface_v1 *layer_surface, uint32_t serial, uint32_t width, uint32_t height) {
+  Output *o = data;
+  bool resized = !o->configured || o->surface_width != (int)width || o->surface_height != (int)height;
+  o->surface_width = width;
+  o->surface_height = height;
+
+  zwlr_layer_surface_v1_ack_configure(layer_surface, serial);
+
+  // an unchanged size keeps whatever is attached, the ack still needs a commit
+  if (resized) {
+    overlay_attach_input_only(o);
+  } else {
+    wl_surface_commit(o->surface);
+  }
+
+  if (o->configured) {
+    return;
+  }
+  o->configured = true;
+  //move cursor to activate pointer enter handler.
+  if(virtual_pointer_manager != NULL) {
+    zwlr_virtual_pointer_v1_motion(virtual_pointer, 1, 1, 0);
+    zwlr_virtual_pointer_v1_frame(virtual_pointer);
+  } else {
+    // return value is unused, using 'system' is enough.
+    system(emulate_cmd);
+  }
+  layer_configured = true;
+}
+
+static void destroy_overlay(Output *o) {
+  if (o->surface == NULL) return;
+  if (o->frame_callback != NULL) {
+    wl_callback_destroy(o->frame_callback);
+    o->frame_callback = NULL;
+  }
+  if (o->feedback != NULL) {
+    wp_presentation_feedback_destroy(o->feedback);
+    o->feedback = NULL;
+  }
+  o->redraw_pending = false;
+  o->shown = (PixelRect){ 0, 0, 0, 0 };
+  o->drawn_radius = -1;
+  shm_pool_finish(&o->shm_pool);
+  wp_viewport_destroy(o->viewport);
+  zwlr_layer_surface_v1_destroy(o->layer_surface);
+  wl_surface_destroy(o->surface);
+  o->viewport = NULL;
+  o->layer_surface = NULL;
+  o->surface = NULL;
+  o->configured = false;
+}
+
+static void layer_surface_handle_closed(void *data, struct zwlr_layer_surface_v1 *layer_surface) {
+  destroy_overlay(data);
+}
+
+static const struct zwlr_layer_surface_v1_listener layer_surface_listener = {
+  .configure = layer_surface_handle_configure,
+  .closed = layer_surface_handle_closed,
+};
+
+static void create_overlay(Output *o) {
+  o->surface = wl_compositor_create_surface(compositor);
+  if (o->surface == NULL) {
+      exit(1);
+  }
+
+  o->layer_surface = zwlr_layer_shell_v1_get_layer_surface(layer_shell, o->surface, o->wl_output, ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY, "find-cursor");
+  zwlr_layer_surface_v1_add_listener(o->layer_surface, &layer_surface_listener, o);
+
+  o->viewport = wp_viewporter_get_viewport(viewporter, o->surface);
+  zwlr_layer_surface_v1_set_anchor(o->layer_surface,
+    ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP |
+    ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT |
+    ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT |
+    ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM);
+  zwlr_layer_surface_v1_set_keyboard_interactivity(o->layer_surface, false);
+  zwlr_layer_surface_v1_set_exclusive_zone(o->layer_surface, -1);
+  wl_surface_commit(o->surface);
+}
+
+static void publish_screen_metrics(const ScreenMetrics *metrics) {
+  const int *values = (const int *)metrics;
+  uint64_t seq = atomic_load_explicit(&screen_metrics.sequence, memory_order_relaxed);
+  atomic_store_explicit(&screen_metrics.sequence, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  for (size_t i = 0; i < sizeof(ScreenMetrics) / sizeof(int); i++) {
+    atomic_store_explicit(&screen_metrics.values[i], values[i], memory_order_relaxed);
+  }
+  atomic_store_explicit(&screen_metrics.sequence, seq + 2, memory_order_release);
+}
+
+static void read_screen_metrics(ScreenMetrics *metrics) {
+  int *values = (int *)metrics;
+  uint64_t before, after;
+  do {
+    before = atomic_load_explicit(&screen_metrics.sequence, memory_order_acquire);
+    for (size_t i = 0; i < sizeof(ScreenMetrics) / sizeof(int); i++) {
+      values[i] = atomic_load_explicit(&screen_metrics.values[i], memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_acquire);
+    after = atomic_load_explicit(&screen_metrics.sequence, memory_order_relaxed);
+  } while ((before & 1) || before != after);
+}
+
+static void update_virtual_screen(void) {
+  ScreenMetrics metrics = {0};
+  if (output_count == 0) {
+    virtual_screen.x = virtual_screen.y = 0;
+    virtual_screen.width = virtual_screen.height = 0;
+    publish_screen_metrics(&metrics);
+    return;
+  }
+  int left = INT_MAX, top = INT_MAX, right = INT_MIN, bottom = INT_MIN;
+  for (int i = 0; i < output_count; i++) {
+    Output *o = outputs[i];
+    if (o->global_x < left) left = o->global_x;
+    if (o->global_y < top) top = o->global_y;
+    if (o->global_x + o->global_width > right) right = o->global_x + o->global_width;
+    if (o->global_y + o->global_height > bottom) bottom = o->global_y + o->global_height;
+  }
+  virtual_screen.x = left;
+  virtual_screen.y = top;
+  virtual_screen.width = right - left;
+  virtual_screen.height = bottom - top;
+
+  Output *primary = outputs[0];
+  for (int i = 0; i < output_count; i++) {
+    if (outputs[i]->global_x == 0 && outputs[i]->global_y == 0) {
+      primary = outputs[i];
+      break;
+    }
+  }
+  metrics.primary_width = primary->global_width;
+  metrics.primary_height = primary->global_height;
+  metrics.virtual_x = virtual_screen.x;
+  metrics.virtual_y = virtual_screen.y;
+  metrics.virtual_width = virtual_screen.width;
+  metrics.virtual_height = virtual_screen.height;
+  metrics.monitors = output_count;
+  publish_screen_metrics(&metrics);
+}
+
+// xdg-output gives the logical region directly; plain wl_output only has
+// the mode in pixels, which is rotated by the transform and divided by scale
+static void output_done(Output *o) {
+  if (o->has_logical) {
+    o->global_x = o->logical_x;
+    o->global_y = o->logical_y;
+    o->global_width = o->logical_width;
+    o->global_height = o->logical_height;
+  } else {
+    int scale = o->scale > 0 ? o->scale : 1;
+    bool rotated = o->transform & 1;  // 90 and 270, flipped or not
+    o->global_x = o->x;
+    o->global_y = o->y;
+    o->global_width = (rotated ? o->mode_height : o->mode_width) / scale;
+    o->global_height = (rotated ? o->mode_width : o->mode_height) / scale;
+  }
+  update_virtual_screen();
+}
+
+static void output_handle_geometry(void *data, struct wl_output *wl_output,
+    int32_t x, int32_t y, int32_t physical_width, int32_t physical_height,
+    int32_t subpixel, const char *make, const char *model, int32_t transform) {
+  Output *o = data;
+  o->x = x;
+  o->y = y;
+  o->transform = transform;
+}
+
+static void output_handle_mode(void *data, struct wl_output *wl_output,
+    uint32_t flags, int32_t width, int32_t height, int32_t refresh) {
+  Output *o = data;
+  if (flags & WL_OUTPUT_MODE_CURRENT) {
+    o->mode_width = width;
+    o->mode_height = height;
+  }
+}
+
+static void output_handle_done(void *data, struct wl_output *wl_output) {
+  output_done(data);
+}
+
+static void output_handle_scale(void *data, struct wl_output *wl_output, int32_t factor) {
+  Output *o = data;
+  o->scale = factor;
+}
+
+static void output_handle_name(void *data, struct wl_output *wl_output, const char *name) {
+}
+
+static void output_handle_description(void *data, struct wl_output *wl_output, const char *description) {
+}
+
+static const struct wl_output_listener output_listener = {
+  .geometry = output_handle_geometry,
+  .mode = output_handle_mode,
+  .done = output_handle_done,
+  .scale = output_handle_scale,
+  .name = output_handle_name,
+  .description = output_handle_description,
+};
+
+static void xdg_output_handle_logical_position(void *data, struct zxdg_output_v1 *xdg_output, int32_t x, int32_t y) {
+  Output *o = data;
+  o->logical_x = x;
+  o->logical_y = y;
+}
+
+static void xdg_output_handle_logical_size(void *data, struct zxdg_output_v1 *xdg_output, int32_t width, int32_t height) {
+  Output *o = data;
+  o->logical_width = width;
+  o->logical_height = height;
+  o->has_logical = true;
+}
+
+// only sent before version 3, later versions finish with wl_output.done
+static void xdg_output_handle_done(void *data, struct zxdg_output_v1 *xdg_output) {
+  output_done(data);
+}
+
+static void xdg_output_handle_name(void *data, struct zxdg_output_v1 *xdg_output, const char *name) {
+}
+
+static void xdg_output_handle_description(void *data, struct zxdg_output_v1 *xdg_output, const char *description) {
+}
+
+static const struct zxdg_output_v1_listener xdg_output_listener = {
+  .logical_position = xdg_output_handle_logical_position,
+  .logical_size = xdg_output_handle_logical_size,
+  .done = xdg_output_handle_done,
+  .name = xdg_output_handle_name,
+  .description = xdg_output_handle_description,
+};
+
+static void watch_xdg_output(Output *o) {
+  if (xdg_output_manager == NULL || o->wl_output == NULL || o->xdg_output != NULL) return;
+  o->xdg_output = zxdg_output_manager_v1_get_xdg_output(xdg_output_manager, o->wl_output);
+  zxdg_output_v1_add_listener(o->xdg_output, &xdg_output_listener, o);
+}
+
+static Output *add_output(struct wl_output *wl_output, uint32_t name) {
+  if (output_count >= MAX_OUTPUTS) {
+    fprintf(stderr, "More than %d outputs, ignoring the rest\n", MAX_OUTPUTS);
+    return NULL;
+  }
+  Output *o = calloc(1, sizeof(Output));
+  o->wl_output = wl_output;
+  o->global_name = name;
+  o->scale = 1;
+  o->drawn_radius = -1;
+  outputs[output_count++] = o;
+  if (wl_output != NULL) {
+    wl_output_add_listener(wl_output, &output_listener, o);
+    watch_xdg_output(o);
+  }
+  // outputs plugged in after init_layer_shell get their overlay right away
+  if (overlays_created) {
+    create_overlay(o);
+  }
+  return o;
+}
+
+static void remove_output(int index) {
+  Output *o = outputs[index];
+  if (o == cursor_output) {
+    cursor_output = NULL;
+  }
+  destroy_overlay(o);
+  if (o->xdg_output != NULL) {
+    zxdg_output_v1_destroy(o->xdg_output);
+  }
+  if (o->wl_output != NULL) {
+    if (wl_output_get_version(o->wl_output) >= WL_OUTPUT_RELEASE_SINCE_VERSION) {
+      wl_output_release(o->wl_output);
+    } else {
+      wl_output_destroy(o->wl_output);
+    }
+  }
+  free(o);
+  output_count--;
+  for (int i = index; i < output_count; i++) {
+    outputs[i] = outputs[i + 1];
+  }
+  update_virtual_screen();
+}
+
 static void global_registry_handler(void *data, struct wl_registry *registry,
     uint32_t id, const char *interface, uint32_t version)
 {
@@ -296,6 +1266,9 @@ static void global_registry_handler(void *data, struct wl_registry *registry,
     layer_shell = wl_registry_bind(registry, id, &zwlr_layer_shell_v1_interface, 2);
   } else if (strcmp(interface, wp_viewporter_interface.name) == 0) {
     viewporter = wl_registry_bind(registry, id, &wp_viewporter_interface, 1);
+  } else if (strcmp(interface, wp_presentation_interface.name) == 0) {
+    presentation = wl_registry_bind(registry, id, &wp_presentation_interface, 1);
+    wp_presentation_add_listener(presentation, &presentation_listener, NULL);
   } else if (strcmp(interface, wp_single_pixel_buffer_manager_v1_interface.name) == 0) {
     single_pixel_buffer_manager = wl_registry_bind(registry, id, &wp_single_pixel_buffer_manager_v1_interface, 1);
   } else if (strcmp(interface, zwlr_virtual_pointer_manager_v1_interface.name) == 0) {
@@ -303,20 +1276,37 @@ static void global_registry_handler(void *data, struct wl_registry *registry,
   }
   else if (strcmp(interface, wl_seat_interface.name) == 0) {
     seat = wl_registry_bind(registry, id, &wl_seat_interface, 1);
+    seat_name = id;
     wl_seat_add_listener(seat, &seat_listener, NULL);//FIXME.
   }
-  
-  // if output is NULL, it will default to focused output, that's what we want.
-  /*else if (strcmp(interface, wl_output_interface.name) == 0) {
-      wl_registry_bind(registry, id, &wl_output_interface, 4);
-      wl_output_add_listener(output, &wl_output_listener, output);
-  } */
+  else if (strcmp(interface, wl_output_interface.name) == 0) {
+    struct wl_output *wl_output = wl_registry_bind(registry, id, &wl_output_interface, version < 4 ? version : 4);
+    if (add_output(wl_output, id) == NULL) {
+      wl_output_destroy(wl_output);
+    }
+  }
+  else if (strcmp(interface, zxdg_output_manager_v1_interface.name) == 0) {
+    xdg_output_manager = wl_registry_bind(registry, id, &zxdg_output_manager_v1_interface, version < 3 ? version : 3);
+    for (int i = 0; i < output_count; i++) {
+      watch_xdg_output(outputs[i]);
+    }
+  }
 }
 
 static void global_registry_remove_handler(void *data, struct wl_registry *registry, uint32_t id)
 {
-  wl_pointer_destroy(pointer);
-  wl_seat_destroy(seat);
+  for (int i = 0; i < output_count; i++) {
+    if (outputs[i]->wl_output != NULL && outputs[i]->global_name == id) {
+      remove_output(i);
+      return;
+    }
+  }
+  if (seat != NULL && id == seat_name) {
+    wl_pointer_destroy(pointer);
+    wl_seat_destroy(seat);
+    pointer = NULL;
+    seat = NULL;
+  }
 }
 
 static const struct wl_registry_listener registry_listener = {
@@ -324,45 +1314,6 @@ static const struct wl_registry_listener registry_listener = {
   .global_remove = global_registry_remove_handler,
 };
 
-static void layer_surface_handle_configure(void *data, struct zwlr_layer_surface_v1 *layer_surface, uint32_t serial, uint32_t width, uint32_t height) {
-  surface_width = width;
-  surface_height = height;
-
-  zwlr_layer_surface_v1_ack_configure(layer_surface, serial);
-
-  struct wl_buffer *buffer = wp_single_pixel_buffer_manager_v1_create_u32_rgba_buffer(single_pixel_buffer_manager, 0, 0, 0, 0);
-  wl_surface_attach(surface, buffer, 0, 0);
-
-  wp_viewport_set_destination(viewport, surface_width, surface_height);
-  wl_surface_damage(surface, 0, 0, INT32_MAX, INT32_MAX);
-  wl_surface_commit(surface);
-
-  wl_buffer_destroy(buffer);
-  //move cursor to activate pointer enter handler.
-  if(virtual_pointer_manager != NULL) {
-    zwlr_virtual_pointer_v1_motion(virtual_pointer, 1, 1, 0);
-    zwlr_virtual_pointer_v1_frame(virtual_pointer);
-  } else {
-    // return value is unused, using 'system' is enough.
-    system(emulate_cmd);
-  }
-  layer_configured = true;
-}
-
-static void layer_surface_handle_closed(void *data, struct zwlr_layer_surface_v1 *layer_surface) {
-  if (frame_callback != NULL) {
-    wl_callback_destroy(frame_callback);
-  }
-  wp_viewport_destroy(viewport);
-  zwlr_layer_surface_v1_destroy(layer_surface);
-  wl_surface_destroy(surface);
-}
-
-static const struct zwlr_layer_surface_v1_listener layer_surface_listener = {
-  .configure = layer_surface_handle_configure,
-  .closed = layer_surface_handle_closed,
-};
-
 void usage() {
   printf("wl-find-cursor - highlight and report cursor position in wayland.\n\n");
   printf("Options:\n");
@@ -375,18 +1326,6 @@ void usage() {
   exit(0);
 }
 
-extern void* update_cursor_pos(void* arg){
-  while (true) {
-        int check = wl_display_dispatch(display);
-        if (check == -1){
-          printf("Error in updating cursor position has occured \n");
-          break;
-        }
-    }
-}
-
-
-
 extern int init_layer_shell()
 {
 
@@ -405,7 +1344,8 @@ extern int init_layer_shell()
     bool found;
   } required_globals[] = {
     { "wl_compositor", compositor != NULL },
-    { "wl_shm", shm != NULL },
+    // the highlight animation is the only user of shm
+    { "wl_shm", shm != NULL || no_animation },
     { "zwlr_layer_shell_v1", layer_shell != NULL },
     { "wp_viewporter", viewporter != NULL },
     { "wp_single_pixel_buffer_manager_v1", single_pixel_buffer_manager != NULL },
@@ -431,25 +1371,17 @@ extern int init_layer_shell()
     }
   }
 
-  wl_display_dispatch(display);
+  // second roundtrip collects output geometry and xdg-output regions
+  wl_display_roundtrip(display);
 
-  surface = wl_compositor_create_surface(compositor);
-  if (surface == NULL) {
-      exit(1);
+  // without any wl_output, a NULL output means the focused one
+  if (output_count == 0) {
+    add_output(NULL, 0);
   }
-
-  layer_surface = zwlr_layer_shell_v1_get_layer_surface(layer_shell, surface, output, ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY, "find-cursor");
-  zwlr_layer_surface_v1_add_listener(layer_surface, &layer_surface_listener, NULL); //FIXME.
-
-  viewport = wp_viewporter_get_viewport(viewporter, surface);
-  zwlr_layer_surface_v1_set_anchor(layer_surface,
-    ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP |
-    ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT |
-    ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT |
-    ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM);
-  zwlr_layer_surface_v1_set_keyboard_interactivity(layer_surface, false);
-  zwlr_layer_surface_v1_set_exclusive_zone(layer_surface, -1);
-  wl_surface_commit(surface);
+  for (int i = 0; i < output_count; i++) {
+    create_overlay(outputs[i]);
+  }
+  overlays_created = true;
 
 
 
@@ -462,12 +1394,13 @@ extern int init_layer_shell()
 }
 
 extern int destroy_layer_shell(){
-  if (frame_callback != NULL) {
-      wl_callback_destroy(frame_callback);
+  while (output_count > 0) {
+    remove_output(output_count - 1);
+  }
+  overlays_created = false;
+  if (xdg_output_manager != NULL) {
+    zxdg_output_manager_v1_destroy(xdg_output_manager);
   }
-  wp_viewport_destroy(viewport);
-  zwlr_layer_surface_v1_destroy(layer_surface);
-  wl_surface_destroy(surface);
 
   wl_pointer_destroy(pointer);
   wl_seat_destroy(seat);
@@ -475,6 +1408,9 @@ extern int destroy_layer_shell(){
   wl_compositor_destroy(compositor);
   zwlr_layer_shell_v1_destroy(layer_shell);
   wp_viewporter_destroy(viewporter);
+  if (presentation != NULL) {
+    wp_presentation_destroy(presentation);
+  }
   wp_single_pixel_buffer_manager_v1_destroy(single_pixel_buffer_manager);
   wl_registry_destroy(registry);
   return 0;
@@ -4,27 +4,32 @@
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
-#include <signal.h>
+#include <errno.h>
+#include <limits.h>
 #include <libinput.h>
 #include <libudev.h>
 #include <linux/input-event-codes.h>
 #include <stdbool.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "structures.h"
+#include "keyState.h"
+#include "hooks.h"
+#include "latency.h"
 
 #define KEY_G_CODE 34
-bool is_button_pressed[256];
 struct udev *udev = NULL;
 int fd_linp;
 
 
 
 
-static int running_libinp = 1;
 static struct libinput *li = NULL;
 
 void print_curr_pressed_buttons(){
-    for (int i = 0; i < 256; i++){
-        if (is_button_pressed[i]){
+    for (int i = 0; i < KEY_CNT; i++){
+        if (key_state_down(i)){
             printf("%d ", i);
         }
     }
@@ -32,11 +37,6 @@ void print_curr_pressed_buttons(){
     return;
 }
 
-void signal_handler(int sig) {
-    (void)sig;  
-    running_libinp = 0;
-}
-
 static int open_restricted(const char *path, int flags, void *user_data) {
     (void)user_data;  
     int fd_linp = open(path, flags);
@@ -53,35 +53,89 @@ static const struct libinput_interface interface = {
     .close_restricted = close_restricted,
 };
 
+// Drains everything libinput has queued in one go; the key state is
+// published once for the whole batch.
 static void handle_events(struct libinput *li) {
     struct libinput_event *ev;
     
+    key_state_write_begin();
     while ((ev = libinput_get_event(li)) != NULL) {
         enum libinput_event_type type = libinput_event_get_type(ev);
         
-        if (type == LIBINPUT_EVENT_KEYBOARD_KEY) {
+        if (type == LIBINPUT_EVENT_DEVICE_ADDED) {
+            struct libinput_device *device = libinput_event_get_device(ev);
+            const char *sysname = libinput_device_get_sysname(device);
+            if (uinput_owns_node(fd_k, sysname) || uinput_owns_node(fd_composite, sysname)) {
+                // our own keyboard: injected keys are not typed keys, the
+                // evdev backend skips these nodes as well. The mode only
+                // applies to this libinput context, not the compositor's.
+                libinput_device_config_send_events_set_mode(device, LIBINPUT_CONFIG_SEND_EVENTS_DISABLED);
+            } else if (libinput_device_has_capability(device, LIBINPUT_DEVICE_CAP_KEYBOARD)) {
+                // libinput keeps the device fd to itself, so the lock LEDs
+                // are read from a short-lived fd of our own
+                char path[PATH_MAX];
+                snprintf(path, sizeof(path), "/dev/input/%s", sysname);
+                int dev_fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+                if (dev_fd >= 0) {
+                    key_state_sync_leds(dev_fd);
+                    close(dev_fd);
+                }
+            }
+        } else if (type == LIBINPUT_EVENT_KEYBOARD_KEY) {
             struct libinput_event_keyboard *key_ev = libinput_event_get_keyboard_event(ev);
             uint32_t key = libinput_event_keyboard_get_key(key_ev);
-            enum libinput_key_state key_state = libinput_event_keyboard_get_key_state(key_ev);
-            if (key_state == LIBINPUT_KEY_STATE_PRESSED) {
+            // seat-wide count: a key held on two keyboards is released
+            // only when the last one lets go
+            uint32_t seat_count = libinput_event_keyboard_get_seat_key_count(key_ev);
+            uint64_t time_us = libinput_event_keyboard_get_time_usec(key_ev);
+            uint32_t time = time_us / 1000;
+            latency_observed(time_us);
+            if (libinput_event_keyboard_get_key_state(key_ev) == LIBINPUT_KEY_STATE_PRESSED) {
                 //printf("%d pressed\n", key);
-                is_button_pressed[key] = 1;
+                if (seat_count == 1) {
+                    key_state_set(key, true);
+                    hook_keyboard_event(key, true, time);
+                }
             } else {
                 //printf("%d released\n", key);
-                is_button_pressed[key] = 0;
+                if (seat_count == 0) {
+                    key_state_set(key, false);
+                    hook_keyboard_event(key, false, time);
+                }
             }
             //print_curr_pressed_buttons();
+        } else if (type == LIBINPUT_EVENT_POINTER_BUTTON) {
+            struct libinput_event_pointer *ptr_ev = libinput_event_get_pointer_event(ev);
+            latency_observed(libinput_event_pointer_get_time_usec(ptr_ev));
+            uint32_t button = libinput_event_pointer_get_button(ptr_ev);
+            uint32_t seat_count = libinput_event_pointer_get_seat_button_count(ptr_ev);
+            if (libinput_event_pointer_get_button_state(ptr_ev) == LIBINPUT_BUTTON_STATE_PRESSED) {
+                if (seat_count == 1) key_state_set(button, true);
+            } else {
+                if (seat_count == 0) key_state_set(button, false);
+            }
+        } else if (type == LIBINPUT_EVENT_POINTER_SCROLL_WHEEL) {
+            // v120 already counts 120 per notch like WHEEL_DELTA, but
+            // libinput scrolls down for positive values
+            struct libinput_event_pointer *ptr_ev = libinput_event_get_pointer_event(ev);
+            latency_observed(libinput_event_pointer_get_time_usec(ptr_ev));
+            if (libinput_event_pointer_has_axis(ptr_ev, LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL)) {
+                key_state_add_wheel(KEY_STATE_WHEEL_VERTICAL,
+                    -(int)libinput_event_pointer_get_scroll_value_v120(ptr_ev, LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL));
+            }
+            if (libinput_event_pointer_has_axis(ptr_ev, LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL)) {
+                key_state_add_wheel(KEY_STATE_WHEEL_HORIZONTAL,
+                    (int)libinput_event_pointer_get_scroll_value_v120(ptr_ev, LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL));
+            }
         }
         
         libinput_event_destroy(ev);
     }
+    key_state_write_end();
 }
 
 int init_libinput(){
 
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
-
     udev = udev_new();
     if (!udev) {
         fprintf(stderr, "Failed to initialize udev\n");
@@ -100,12 +154,15 @@ int init_libinput(){
         return 1;
     }
     fd_linp = libinput_get_fd(li);
+    atomic_store(&key_state_pointer_from_libinput, true);
     return 0;
 }
 
 void destroy_libinput(){
+    atomic_store(&key_state_pointer_from_libinput, false);
     if (li) {
         libinput_unref(li);
+        li = NULL;
     }
     if (udev) {
         udev_unref(udev);
@@ -113,31 +170,136 @@ void destroy_libinput(){
     return;
 }
 
-void *check_buttons(void *arg){
-    while (running_libinp) {
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET(fd_linp, &fds);
-        
-        struct timeval tv = {1, 0};
-        int ret = select(fd_linp + 1, &fds, NULL, NULL, &tv);
-        
-        if (ret > 0 && FD_ISSET(fd_linp, &fds)) {
-            libinput_dispatch(li);
-            handle_events(li);
-        } else if (ret == 0) {
-            continue;
-        } else {
-            break;
-        }
+// event loop handler for the libinput fd
+static void libinput_readable(void *data, uint32_t events){
+    libinput_dispatch(li);
+    handle_events(li);
+}
+
+// VK_SHIFT, VK_CONTROL and VK_MENU are down when either side is
+static bool vk_generic_down(int vk, bool down){
+    switch (vk){
+        case VK_SHIFT:   return down || key_state_down(KEY_RIGHTSHIFT);
+        case VK_CONTROL: return down || key_state_down(KEY_RIGHTCTRL);
+        case VK_MENU:    return down || key_state_down(KEY_RIGHTALT);
     }
-    return 0;
+    return down;
 }
 
+// High bit: the key is down. Low bit: the key is toggled, which flips on
+// every press and is what Caps, Num and Scroll Lock report.
 short GetKeyState(int nVirtKey){
     short linux_key = winapi_to_linux_key(nVirtKey);
-    if (is_button_pressed[linux_key]){
-        return 0x8000;
+    if (linux_key < 0){
+        return 0x0000;
+    }
+    unsigned short state = 0;
+    if (vk_generic_down(nVirtKey, key_state_down(linux_key))){
+        state |= 0x8000;
+    }
+    if (key_state_toggled(linux_key)){
+        state |= 0x0001;
+    }
+    return (short)state;
+}
+
+// High bit: the key is down right now. Low bit: it was pressed since the
+// previous GetAsyncKeyState call for that key, from any thread.
+short GetAsyncKeyState(int vKey){
+    short linux_key = winapi_to_linux_key(vKey);
+    if (linux_key < 0){
+        return 0x0000;
     }
-    return 0x0000;
+    unsigned short state = 0;
+    if (vk_generic_down(vKey, key_state_down(linux_key))){
+        state |= 0x8000;
+    }
+    if (key_state_take_pressed(linux_key)){
+        state |= 0x0001;
+    }
+    return (short)state;
+}
+
+// codes below this are expanded to bytes; the VK table tops out at
+// KEY_ZOOM (372), the rest of the bitset is never looked up by a VK
+#define KEY_STATE_EXPANDED_CODES 384
+
+#define VK_KEY_EXPANDED_CHECK(vk, key) \
+    _Static_assert((key) < KEY_STATE_EXPANDED_CODES, #key " is past the expanded codes");
+VK_KEY_MAPPINGS(VK_KEY_EXPANDED_CHECK)
+VK_KEY_FORWARD_ONLY(VK_KEY_EXPANDED_CHECK)
+
+// only the VKs that have a key, so unmapped slots cost nothing
+typedef struct {
+    BYTE vk;
+    unsigned short code;
+} VkKeyPair;
+
+#define VK_KEY_PAIR_ENTRY(vk, key) { vk, key },
+static const VkKeyPair vk_key_pairs[] = {
+    VK_KEY_MAPPINGS(VK_KEY_PAIR_ENTRY)
+    VK_KEY_FORWARD_ONLY(VK_KEY_PAIR_ENTRY)
+};
+
+#ifdef __SSE2__
+// 16 key bits to 16 bytes, value where the bit is set and 0 elsewhere
+static __m128i key_bits_to_bytes(uint32_t bits, __m128i value){
+    const __m128i bit = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                      1, 2, 4, 8, 16, 32, 64, -128);
+    __m128i v = _mm_cvtsi32_si128(bits);
+    v = _mm_unpacklo_epi8(v, v);   // lo lo hi hi
+    v = _mm_unpacklo_epi16(v, v);  // lo x4, hi x4
+    v = _mm_unpacklo_epi32(v, v);  // lo x8, hi x8
+    v = _mm_cmpeq_epi8(_mm_and_si128(v, bit), bit);
+    return _mm_and_si128(v, value);
+}
+#endif
+
+// Fills all 256 VK slots from one snapshot of the key bitset: 0x80 when
+// down, 0x01 when toggled. The snapshot is first spread to one byte per
+// code, 16 codes per SSE2 step, then each mapped VK is a single byte copy
+// and the unmapped ones stay 0.
+bool GetKeyboardState(BYTE *lpKeyState){
+    if (lpKeyState == NULL){
+        return 0;
+    }
+    KeyStateSnapshot snapshot;
+    key_state_snapshot(&snapshot);
+
+    _Alignas(16) BYTE code_state[KEY_STATE_EXPANDED_CODES];
+#ifdef __SSE2__
+    const __m128i down_value = _mm_set1_epi8((char)0x80);
+    const __m128i toggled_value = _mm_set1_epi8(0x01);
+    for (int code = 0; code < KEY_STATE_EXPANDED_CODES; code += 16){
+        unsigned int word = code / 64, shift = code % 64;
+        __m128i bytes = _mm_or_si128(
+            key_bits_to_bytes((snapshot.down[word] >> shift) & 0xffff, down_value),
+            key_bits_to_bytes((snapshot.toggled[word] >> shift) & 0xffff, toggled_value));
+        _mm_store_si128((__m128i *)(code_state + code), bytes);
+    }
+#else
+    for (int code = 0; code < KEY_STATE_EXPANDED_CODES; code++){
+        unsigned int word = code / 64, bit = code % 64;
+        code_state[code] = (BYTE)((((snapshot.down[word] >> bit) & 1) << 7) |
+                                  ((snapshot.toggled[word] >> bit) & 1));
+    }
+#endif
+    memset(lpKeyState, 0, 256);
+    for (size_t i = 0; i < sizeof(vk_key_pairs) / sizeof(vk_key_pairs[0]); i++){
+        lpKeyState[vk_key_pairs[i].vk] = code_state[vk_key_pairs[i].code];
+    }
+    lpKeyState[VK_SHIFT] |= (lpKeyState[VK_LSHIFT] | lpKeyState[VK_RSHIFT]) & 0x80;
+    lpKeyState[VK_CONTROL] |= (lpKeyState[VK_LCONTROL] | lpKeyState[VK_RCONTROL]) & 0x80;
+    lpKeyState[VK_MENU] |= (lpKeyState[VK_LMENU] | lpKeyState[VK_RMENU]) & 0x80;
+    return 1;
+}
+
+// Wheel movement accumulated since startup, in WHEEL_DELTA units. Callers
+// keep the previous values and subtract to get the movement in between.
+bool GetWheelDelta(long *vertical, long *horizontal){
+    KeyStateSnapshot snapshot;
+    key_state_snapshot(&snapshot);
+    if (vertical != NULL) *vertical = snapshot.wheel[KEY_STATE_WHEEL_VERTICAL];
+    if (horizontal != NULL) *horizontal = snapshot.wheel[KEY_STATE_WHEEL_HORIZONTAL];
+    return 1;
 }
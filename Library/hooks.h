@@ -0,0 +1,317 @@
+// hooks.h - WH_KEYBOARD_LL / WH_MOUSE_LL hooks run on a callback thread
+#ifndef HOOKS_H
+#define HOOKS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include "structures.h"
+#include "keyState.h"
+
+#define MAX_HOOKS 16
+// must be a power of two
+#define HOOK_QUEUE_SIZE 1024
+#define HOOK_QUEUE_MASK (HOOK_QUEUE_SIZE - 1)
+
+typedef struct {
+    uint64_t events;            // callbacks made
+    uint64_t callback_ns;       // total time spent in the callback
+    uint64_t max_callback_ns;
+    uint64_t max_queue_ns;      // longest an event waited before this hook saw it
+    uint32_t max_queue_depth;   // events still queued behind the one delivered
+    uint64_t dropped;           // events lost to a full queue, shared by all hooks
+} HookStats;
+
+typedef struct Hook {
+    _Atomic(HOOKPROC) proc;  // NULL when the slot is free
+    int type;
+    _Atomic uint64_t events;
+    _Atomic uint64_t callback_ns;
+    _Atomic uint64_t max_callback_ns;
+    _Atomic uint64_t max_queue_ns;
+    _Atomic uint32_t max_queue_depth;
+} Hook;
+
+typedef Hook *HHOOK;
+
+typedef struct {
+    int type;
+    WPARAM message;
+    union {
+        KBDLLHOOKSTRUCT kb;
+        MSLLHOOKSTRUCT ms;
+    };
+    int64_t queued_ns;
+} HookEvent;
+
+// same slot protocol as the injector queue: free for position p when
+// sequence == p, published when sequence == p + 1
+typedef struct {
+    _Alignas(64) _Atomic size_t sequence;
+    HookEvent event;
+} HookSlot;
+
+typedef struct {
+    _Alignas(64) _Atomic size_t head;
+    _Alignas(64) _Atomic int sleeping;
+    _Atomic bool running;
+    _Atomic int installed[2];  // keyboard and mouse hook counts
+    _Atomic uint64_t dropped;
+    size_t tail;               // owned by the callback thread
+    int wake_fd;
+    pthread_t thread;
+    pthread_mutex_t lock;      // install/remove only
+    Hook hooks[MAX_HOOKS];
+    HookSlot slots[HOOK_QUEUE_SIZE];
+} HookQueue;
+
+HookQueue hook_queue = { .wake_fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static int64_t hook_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool hooks_wanted(int type) {
+    return atomic_load_explicit(&hook_queue.installed[type == WH_MOUSE_LL],
+                                memory_order_relaxed) > 0;
+}
+
+// Never blocks the input thread: a full queue drops the event and counts it.
+static void hook_post(const HookEvent *event) {
+    size_t pos = atomic_load_explicit(&hook_queue.head, memory_order_relaxed);
+    HookSlot *slot;
+    for (;;) {
+        slot = &hook_queue.slots[pos & HOOK_QUEUE_MASK];
+        size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&hook_queue.head, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&hook_queue.dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&hook_queue.head, memory_order_relaxed);
+        }
+    }
+    slot->event = *event;
+    slot->event.queued_ns = hook_now_ns();
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_exchange(&hook_queue.sleeping, 0)) {
+        uint64_t one = 1;
+        write(hook_queue.wake_fd, &one, sizeof(one));
+    }
+}
+
+// Key reader side, called after the key state was updated: code is an
+// evdev KEY_* code, time in milliseconds.
+static void hook_keyboard_event(unsigned int code, bool down, uint32_t time) {
+    if (!hooks_wanted(WH_KEYBOARD_LL) || code >= KEY_CNT) return;
+    HookEvent event = { .type = WH_KEYBOARD_LL };
+    event.kb.vkCode = linux_key_to_vk[code];
+    event.kb.scanCode = code;
+    event.kb.flags = down ? 0 : LLKHF_UP;
+    event.kb.time = time;
+    // Alt held turns key messages into their WM_SYS* forms
+    if (key_state_down(KEY_LEFTALT) || key_state_down(KEY_RIGHTALT)) {
+        event.kb.flags |= LLKHF_ALTDOWN;
+        event.message = down ? WM_SYSKEYDOWN : WM_SYSKEYUP;
+    } else {
+        event.message = down ? WM_KEYDOWN : WM_KEYUP;
+    }
+    hook_post(&event);
+}
+
+// pointer side: x, y in global desktop coordinates
+static void hook_mouse_event(WPARAM message, int x, int y, DWORD mouse_data, uint32_t time) {
+    if (!hooks_wanted(WH_MOUSE_LL)) return;
+    HookEvent event = { .type = WH_MOUSE_LL, .message = message };
+    event.ms.pt.x = x;
+    event.ms.pt.y = y;
+    event.ms.mouseData = mouse_data;
+    event.ms.time = time;
+    hook_post(&event);
+}
+
+static bool hook_pending() {
+    HookSlot *slot = &hook_queue.slots[hook_queue.tail & HOOK_QUEUE_MASK];
+    return atomic_load_explicit(&slot->sequence, memory_order_acquire) == hook_queue.tail + 1;
+}
+
+static void hook_store_max(_Atomic uint64_t *max, uint64_t value) {
+    if (value > atomic_load_explicit(max, memory_order_relaxed)) {
+        atomic_store_explicit(max, value, memory_order_relaxed);
+    }
+}
+
+static void hook_dispatch(HookEvent *event) {
+    uint32_t depth = (uint32_t)(atomic_load_explicit(&hook_queue.head, memory_order_relaxed) -
+                                hook_queue.tail);
+    for (int i = 0; i < MAX_HOOKS; i++) {
+        Hook *hook = &hook_queue.hooks[i];
+        HOOKPROC proc = atomic_load_explicit(&hook->proc, memory_order_acquire);
+        if (proc == NULL || hook->type != event->type) continue;
+
+        int64_t start = hook_now_ns();
+        proc(HC_ACTION, event->message, (LPARAM)&event->kb);
+        int64_t end = hook_now_ns();
+
+        atomic_fetch_add_explicit(&hook->events, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&hook->callback_ns, end - start, memory_order_relaxed);
+        hook_store_max(&hook->max_callback_ns, end - start);
+        hook_store_max(&hook->max_queue_ns, start - event->queued_ns);
+        if (depth > atomic_load_explicit(&hook->max_queue_depth, memory_order_relaxed)) {
+            atomic_store_explicit(&hook->max_queue_depth, depth, memory_order_relaxed);
+        }
+    }
+}
+
+static void hook_drain() {
+    while (hook_pending()) {
+        HookSlot *slot = &hook_queue.slots[hook_queue.tail & HOOK_QUEUE_MASK];
+        HookEvent event = slot->event;
+        atomic_store_explicit(&slot->sequence, hook_queue.tail + HOOK_QUEUE_SIZE,
+                              memory_order_release);
+        hook_queue.tail++;
+        hook_dispatch(&event);
+    }
+}
+
+// Delivers events strictly in queue order; a slow callback delays the ones
+// behind it but never the input thread.
+static void *hook_thread(void *arg) {
+    while (atomic_load_explicit(&hook_queue.running, memory_order_relaxed)) {
+        if (hook_pending()) {
+            hook_drain();
+            continue;
+        }
+
+        atomic_store(&hook_queue.sleeping, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (hook_pending() || !atomic_load(&hook_queue.running)) {
+            atomic_store(&hook_queue.sleeping, 0);
+            continue;
+        }
+        uint64_t value;
+        read(hook_queue.wake_fd, &value, sizeof(value));
+    }
+    hook_drain();
+    return NULL;
+}
+
+// called with hook_queue.lock held
+static int start_hook_thread() {
+    if (atomic_load(&hook_queue.running)) return 0;
+
+    for (size_t i = 0; i < HOOK_QUEUE_SIZE; i++) {
+        atomic_init(&hook_queue.slots[i].sequence, i);
+    }
+    atomic_init(&hook_queue.head, 0);
+    atomic_init(&hook_queue.sleeping, 0);
+    hook_queue.tail = 0;
+
+    hook_queue.wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (hook_queue.wake_fd < 0) {
+        perror("eventfd");
+        return -1;
+    }
+    atomic_store(&hook_queue.running, true);
+    if (pthread_create(&hook_queue.thread, NULL, hook_thread, NULL) != 0) {
+        fprintf(stderr, "Failed to start hook thread\n");
+        atomic_store(&hook_queue.running, false);
+        close(hook_queue.wake_fd);
+        hook_queue.wake_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+// Only WH_KEYBOARD_LL and WH_MOUSE_LL are supported; hmod and dwThreadId
+// are ignored. Hooks observe input, their return value cannot swallow it.
+extern HHOOK SetWindowsHookEx(int idHook, HOOKPROC lpfn, void *hmod, DWORD dwThreadId) {
+    if ((idHook != WH_KEYBOARD_LL && idHook != WH_MOUSE_LL) || lpfn == NULL) return NULL;
+
+    pthread_mutex_lock(&hook_queue.lock);
+    Hook *hook = NULL;
+    if (start_hook_thread() == 0) {
+        for (int i = 0; i < MAX_HOOKS; i++) {
+            if (atomic_load(&hook_queue.hooks[i].proc) == NULL) {
+                hook = &hook_queue.hooks[i];
+                break;
+            }
+        }
+    }
+    if (hook != NULL) {
+        hook->type = idHook;
+        atomic_store(&hook->events, 0);
+        atomic_store(&hook->callback_ns, 0);
+        atomic_store(&hook->max_callback_ns, 0);
+        atomic_store(&hook->max_queue_ns, 0);
+        atomic_store(&hook->max_queue_depth, 0);
+        atomic_store_explicit(&hook->proc, lpfn, memory_order_release);
+        atomic_fetch_add(&hook_queue.installed[idHook == WH_MOUSE_LL], 1);
+    } else {
+        fprintf(stderr, "Too many hooks\n");
+    }
+    pthread_mutex_unlock(&hook_queue.lock);
+    return hook;
+}
+
+// An event already being dispatched may still reach the hook once.
+extern bool UnhookWindowsHookEx(HHOOK hhk) {
+    if (hhk == NULL) return 0;
+    pthread_mutex_lock(&hook_queue.lock);
+    bool removed = atomic_exchange(&hhk->proc, NULL) != NULL;
+    if (removed) atomic_fetch_sub(&hook_queue.installed[hhk->type == WH_MOUSE_LL], 1);
+    pthread_mutex_unlock(&hook_queue.lock);
+    return removed;
+}
+
+// every installed hook already receives every event
+extern LRESULT CallNextHookEx(HHOOK hhk, int nCode, WPARAM wParam, LPARAM lParam) {
+    return 0;
+}
+
+extern bool GetHookStats(HHOOK hhk, HookStats *stats) {
+    if (hhk == NULL || stats == NULL || atomic_load(&hhk->proc) == NULL) return 0;
+    stats->events = atomic_load_explicit(&hhk->events, memory_order_relaxed);
+    stats->callback_ns = atomic_load_explicit(&hhk->callback_ns, memory_order_relaxed);
+    stats->max_callback_ns = atomic_load_explicit(&hhk->max_callback_ns, memory_order_relaxed);
+    stats->max_queue_ns = atomic_load_explicit(&hhk->max_queue_ns, memory_order_relaxed);
+    stats->max_queue_depth = atomic_load_explicit(&hhk->max_queue_depth, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&hook_queue.dropped, memory_order_relaxed);
+    return 1;
+}
+
+// Delivers what is already queued, then stops the callback thread and
+// removes every hook.
+extern void stop_hooks() {
+    pthread_mutex_lock(&hook_queue.lock);
+    if (atomic_load(&hook_queue.running)) {
+        atomic_store(&hook_queue.running, false);
+        uint64_t one = 1;
+        write(hook_queue.wake_fd, &one, sizeof(one));
+        pthread_join(hook_queue.thread, NULL);
+        close(hook_queue.wake_fd);
+        hook_queue.wake_fd = -1;
+    }
+    for (int i = 0; i < MAX_HOOKS; i++) {
+        atomic_store(&hook_queue.hooks[i].proc, NULL);
+    }
+    atomic_store(&hook_queue.installed[0], 0);
+    atomic_store(&hook_queue.installed[1], 0);
+    pthread_mutex_unlock(&hook_queue.lock);
+}
+
+#endif
@@ -0,0 +1,212 @@
+// injector.h - asynchronous input injection through a lock-free MPSC queue
+#ifndef INJECTOR_H
+#define INJECTOR_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include "eventBatch.h"
+
+// must be a power of two
+#define INJECT_QUEUE_SIZE 4096
+#define INJECT_QUEUE_MASK (INJECT_QUEUE_SIZE - 1)
+
+// set before MAIN_INIT to route SendInput/SetCursorPos/mouseMove through the injector thread
+bool async_input = false;
+
+// A slot is free for position p when sequence == p and holds a published
+// frame for position p when sequence == p + 1.
+typedef struct {
+    _Alignas(64) _Atomic size_t sequence;
+    InputFrame frame;
+} InjectSlot;
+
+typedef struct {
+    _Alignas(64) _Atomic size_t head;       // next position handed to producers
+    _Alignas(64) _Atomic size_t completed;  // positions already written to the devices
+    _Alignas(64) _Atomic int sleeping;
+    _Atomic int flush_waiters;
+    _Atomic bool running;
+    _Atomic bool accepting;                 // cleared first by stop_injector
+    _Atomic int producers;                  // between injector_enter and injector_leave
+    size_t tail;                            // owned by the injector thread
+    int wake_fd;
+    pthread_t thread;
+    pthread_mutex_t flush_lock;
+    pthread_cond_t flush_cond;
+    InjectSlot slots[INJECT_QUEUE_SIZE];
+} Injector;
+
+Injector injector = { .wake_fd = -1,
+                      .flush_lock = PTHREAD_MUTEX_INITIALIZER,
+                      .flush_cond = PTHREAD_COND_INITIALIZER };
+
+static bool injector_active() {
+    return atomic_load_explicit(&injector.running, memory_order_acquire);
+}
+
+// Producers bracket reserve..publish with these, so stop_injector knows
+// when nothing more can be published. Once stopping has begun enter fails
+// and the caller writes synchronously instead.
+static bool injector_enter() {
+    atomic_fetch_add(&injector.producers, 1);
+    if (atomic_load(&injector.accepting)) return true;
+    atomic_fetch_sub(&injector.producers, 1);
+    return false;
+}
+
+static void injector_leave() {
+    atomic_fetch_sub_explicit(&injector.producers, 1, memory_order_release);
+}
+
+// Reserves n consecutive positions so one SendInput call is never interleaved
+// with frames from other producers. Slots are freed in order, so the last slot
+// of the range being free means the whole range is.
+static size_t injector_reserve(size_t n) {
+    size_t pos = atomic_load_explicit(&injector.head, memory_order_relaxed);
+    for (;;) {
+        InjectSlot *last = &injector.slots[(pos + n - 1) & INJECT_QUEUE_MASK];
+        size_t seq = atomic_load_explicit(&last->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + n - 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&injector.head, &pos, pos + n,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                return pos;
+            }
+        } else {
+            if (diff < 0) {
+                // queue full, let the injector drain it
+                sched_yield();
+            }
+            pos = atomic_load_explicit(&injector.head, memory_order_relaxed);
+        }
+    }
+}
+
+static InputFrame *injector_frame(size_t pos) {
+    return &injector.slots[pos & INJECT_QUEUE_MASK].frame;
+}
+
+static void injector_publish(size_t pos, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        atomic_store_explicit(&injector.slots[(pos + i) & INJECT_QUEUE_MASK].sequence,
+                              pos + i + 1, memory_order_release);
+    }
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_exchange(&injector.sleeping, 0)) {
+        uint64_t one = 1;
+        write(injector.wake_fd, &one, sizeof(one));
+    }
+}
+
+static bool injector_pending() {
+    InjectSlot *slot = &injector.slots[injector.tail & INJECT_QUEUE_MASK];
+    return atomic_load_explicit(&slot->sequence, memory_order_acquire) == injector.tail + 1;
+}
+
+// Drains everything published so far into one batch, so frames queued by
+// several producers between wakeups leave in as few writes as possible.
+static void *injector_thread(void *arg) {
+    EventBatch batch;
+    batch_init(&batch, -1);
+
+    while (atomic_load_explicit(&injector.running, memory_order_relaxed)) {
+        if (injector_pending()) {
+            do {
+                InjectSlot *slot = &injector.slots[injector.tail & INJECT_QUEUE_MASK];
+                batch_frame(&batch, &slot->frame);
+                atomic_store_explicit(&slot->sequence, injector.tail + INJECT_QUEUE_SIZE,
+                                      memory_order_release);
+                injector.tail++;
+            } while (injector_pending());
+            batch_flush(&batch);
+
+            atomic_store(&injector.completed, injector.tail);
+            if (atomic_load(&injector.flush_waiters) > 0) {
+                pthread_mutex_lock(&injector.flush_lock);
+                pthread_cond_broadcast(&injector.flush_cond);
+                pthread_mutex_unlock(&injector.flush_lock);
+            }
+            continue;
+        }
+
+        atomic_store(&injector.sleeping, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (injector_pending() || !atomic_load(&injector.running)) {
+            atomic_store(&injector.sleeping, 0);
+            continue;
+        }
+        uint64_t value;
+        read(injector.wake_fd, &value, sizeof(value));
+    }
+    return NULL;
+}
+
+extern int start_injector() {
+    if (injector_active()) return 0;
+
+    for (size_t i = 0; i < INJECT_QUEUE_SIZE; i++) {
+        atomic_init(&injector.slots[i].sequence, i);
+    }
+    atomic_init(&injector.head, 0);
+    atomic_init(&injector.completed, 0);
+    atomic_init(&injector.sleeping, 0);
+    injector.tail = 0;
+
+    injector.wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (injector.wake_fd < 0) {
+        perror("eventfd");
+        return -1;
+    }
+    atomic_store(&injector.running, true);
+    atomic_store(&injector.accepting, true);
+    if (pthread_create(&injector.thread, NULL, injector_thread, NULL) != 0) {
+        fprintf(stderr, "Failed to start injector thread\n");
+        atomic_store(&injector.accepting, false);
+        atomic_store(&injector.running, false);
+        close(injector.wake_fd);
+        injector.wake_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+// Blocks until every frame queued before the call has been written to its device.
+extern void FlushInput() {
+    if (!injector_active()) return;
+
+    size_t target = atomic_load(&injector.head);
+    pthread_mutex_lock(&injector.flush_lock);
+    atomic_fetch_add(&injector.flush_waiters, 1);
+    while (atomic_load(&injector.completed) < target) {
+        pthread_cond_wait(&injector.flush_cond, &injector.flush_lock);
+    }
+    atomic_fetch_sub(&injector.flush_waiters, 1);
+    pthread_mutex_unlock(&injector.flush_lock);
+}
+
+// No frame published before the call returns is lost: producers are shut
+// out first, the ones already inside get to publish, then the queue is
+// drained before the thread exits.
+extern void stop_injector() {
+    if (!injector_active()) return;
+
+    atomic_store(&injector.accepting, false);
+    while (atomic_load_explicit(&injector.producers, memory_order_acquire) > 0) {
+        sched_yield();
+    }
+    FlushInput();
+    atomic_store(&injector.running, false);
+    uint64_t one = 1;
+    write(injector.wake_fd, &one, sizeof(one));
+    pthread_join(injector.thread, NULL);
+    close(injector.wake_fd);
+    injector.wake_fd = -1;
+}
+
+#endif
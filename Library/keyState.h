@@ -0,0 +1,155 @@
+// keyState.h - pressed/toggled state of every evdev key and button, and
+// the accumulated mouse wheel
+#ifndef KEY_STATE_H
+#define KEY_STATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+
+#define KEY_STATE_WORDS ((KEY_CNT + 63) / 64)
+
+// One bit per evdev code (keys and buttons, 0 .. KEY_MAX). Written by the
+// input thread with atomic or/and/xor, read lock-free from any thread.
+// Each set starts on its own cache line so readers of the down bits do
+// not bounce the line GetAsyncKeyState clears.
+typedef struct {
+    // seqlock over the bit sets and the wheel for whole snapshots; the input
+    // thread is the only writer
+    _Alignas(64) _Atomic uint64_t sequence;
+    // wheel movement since startup in WHEEL_DELTA units (120 per notch),
+    // vertical positive away from the user, horizontal positive to the right
+    _Atomic int64_t wheel[2];
+    _Alignas(64) _Atomic uint64_t down[KEY_STATE_WORDS];
+    // set on every press, cleared when GetAsyncKeyState reports it
+    _Alignas(64) _Atomic uint64_t pressed[KEY_STATE_WORDS];
+    // flipped on every press, the low bit of GetKeyState
+    _Alignas(64) _Atomic uint64_t toggled[KEY_STATE_WORDS];
+} KeyStateBits;
+
+KeyStateBits key_state;
+
+#define KEY_STATE_WHEEL_VERTICAL 0
+#define KEY_STATE_WHEEL_HORIZONTAL 1
+
+// Set while libinput feeds pointer buttons and wheel, so the wayland
+// pointer listener does not count the same click or notch twice.
+_Atomic bool key_state_pointer_from_libinput = false;
+
+typedef struct {
+    uint64_t down[KEY_STATE_WORDS];
+    uint64_t toggled[KEY_STATE_WORDS];
+    int64_t wheel[2];
+} KeyStateSnapshot;
+
+// Writer-side nesting, so a whole batch of key events is published as one
+// update and snapshots never see half of it. There is exactly one writer
+// thread: the libinput or evdev reader and the wayland pointer listener
+// all run on the event loop thread, and their setup in MAIN_INIT finishes
+// before that thread starts. A second writer would break the seqlock
+// itself, not only this counter.
+static int key_state_write_depth = 0;
+
+static void key_state_write_begin() {
+    if (key_state_write_depth++ > 0) return;
+    uint64_t seq = atomic_load_explicit(&key_state.sequence, memory_order_relaxed);
+    atomic_store_explicit(&key_state.sequence, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void key_state_write_end() {
+    if (--key_state_write_depth > 0) return;
+    uint64_t seq = atomic_load_explicit(&key_state.sequence, memory_order_relaxed);
+    atomic_store_explicit(&key_state.sequence, seq + 1, memory_order_release);
+}
+
+// KEY_RESERVED (0) is never set, so VKs without a key can point at it
+static void key_state_set(unsigned int code, bool down) {
+    if (code == KEY_RESERVED || code >= KEY_CNT) return;
+    uint64_t mask = 1ull << (code % 64);
+    unsigned int word = code / 64;
+    key_state_write_begin();
+    if (down) {
+        uint64_t old = atomic_fetch_or_explicit(&key_state.down[word], mask, memory_order_release);
+        if (!(old & mask)) {
+            atomic_fetch_or_explicit(&key_state.pressed[word], mask, memory_order_relaxed);
+            atomic_fetch_xor_explicit(&key_state.toggled[word], mask, memory_order_relaxed);
+        }
+    } else {
+        atomic_fetch_and_explicit(&key_state.down[word], ~mask, memory_order_release);
+    }
+    key_state_write_end();
+}
+
+static void key_state_add_wheel(int axis, int delta) {
+    key_state_write_begin();
+    atomic_fetch_add_explicit(&key_state.wheel[axis], delta, memory_order_relaxed);
+    key_state_write_end();
+}
+
+// all down and toggled bits and the wheel as of one instant
+static void key_state_snapshot(KeyStateSnapshot *snapshot) {
+    uint64_t before, after;
+    do {
+        before = atomic_load_explicit(&key_state.sequence, memory_order_acquire);
+        snapshot->wheel[0] = atomic_load_explicit(&key_state.wheel[0], memory_order_relaxed);
+        snapshot->wheel[1] = atomic_load_explicit(&key_state.wheel[1], memory_order_relaxed);
+        for (int i = 0; i < KEY_STATE_WORDS; i++) {
+            snapshot->down[i] = atomic_load_explicit(&key_state.down[i], memory_order_relaxed);
+            snapshot->toggled[i] = atomic_load_explicit(&key_state.toggled[i], memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&key_state.sequence, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+}
+
+static bool key_state_down(unsigned int code) {
+    if (code >= KEY_CNT) return false;
+    uint64_t bits = atomic_load_explicit(&key_state.down[code / 64], memory_order_acquire);
+    return (bits >> (code % 64)) & 1;
+}
+
+static bool key_state_toggled(unsigned int code) {
+    if (code >= KEY_CNT) return false;
+    uint64_t bits = atomic_load_explicit(&key_state.toggled[code / 64], memory_order_relaxed);
+    return (bits >> (code % 64)) & 1;
+}
+
+// returns whether code was pressed since the previous call and clears it
+static bool key_state_take_pressed(unsigned int code) {
+    if (code >= KEY_CNT) return false;
+    uint64_t mask = 1ull << (code % 64);
+    uint64_t old = atomic_fetch_and_explicit(&key_state.pressed[code / 64], ~mask, memory_order_relaxed);
+    return old & mask;
+}
+
+// for lock keys whose LED state is known from elsewhere
+static void key_state_set_toggled(unsigned int code, bool on) {
+    if (code == KEY_RESERVED || code >= KEY_CNT) return;
+    uint64_t mask = 1ull << (code % 64);
+    key_state_write_begin();
+    if (on) {
+        atomic_fetch_or_explicit(&key_state.toggled[code / 64], mask, memory_order_relaxed);
+    } else {
+        atomic_fetch_and_explicit(&key_state.toggled[code / 64], ~mask, memory_order_relaxed);
+    }
+    key_state_write_end();
+}
+
+// Seeds the Caps, Num and Scroll Lock toggles from the LEDs of an open
+// evdev node; the kernel keeps them the same on every keyboard.
+static void key_state_sync_leds(int dev_fd) {
+    uint8_t leds[(LED_CNT + 7) / 8];
+    memset(leds, 0, sizeof(leds));
+    if (ioctl(dev_fd, EVIOCGLED(sizeof(leds)), leds) < 0) return;
+    key_state_write_begin();
+    key_state_set_toggled(KEY_CAPSLOCK, leds[LED_CAPSL / 8] & (1 << (LED_CAPSL % 8)));
+    key_state_set_toggled(KEY_NUMLOCK, leds[LED_NUML / 8] & (1 << (LED_NUML % 8)));
+    key_state_set_toggled(KEY_SCROLLLOCK, leds[LED_SCROLLL / 8] & (1 << (LED_SCROLLL % 8)));
+    key_state_write_end();
+}
+
+#endif
@@ -5,6 +5,9 @@
 #include <fcntl.h>
 #include <linux/input.h>
 #include <linux/uinput.h>
+#include "deviceReady.h"
+#include "structures.h"
+#include "outputBackend.h"
 
 int fd_k = -1;
 struct uinput_setup usetup;
@@ -21,18 +24,31 @@ extern void emit(int type, int code, int val) {
     ie.type = type;
     ie.code = code;
     ie.value = val;
-   
-    ie.time.tv_sec = 0;
-    ie.time.tv_usec = 0;
 
-    if (write(fd_k, &ie, sizeof(ie)) < 0) {
+    if (output_write(fd_k, &ie, 1) < 0) {
         perror("write event");
         exit(1);
     }
     ie.type = EV_SYN;
     ie.code = SYN_REPORT;
     ie.value = 0;
-    write(fd_k, &ie, sizeof(ie));
+    output_write(fd_k, &ie, 1);
+}
+
+// registers the keyboard keys on dev_fd before UI_DEV_SETUP: the 1..248
+// block plus every higher code the VK table maps to (KEY_SELECT, KEY_ZOOM...),
+// the kernel drops codes a device did not register
+static void keyboard_setup_bits(int dev_fd){
+    ioctl(dev_fd, UI_SET_EVBIT, EV_KEY);
+    for (int key = 1; key <= 248; key++) {
+        ioctl(dev_fd, UI_SET_KEYBIT, key);
+    }
+    for (int vk = 0; vk < 256; vk++) {
+        short key = vk_to_linux_key[vk];
+        if (key > 248 && !linux_key_is_mouse_button(key)) {
+            ioctl(dev_fd, UI_SET_KEYBIT, key);
+        }
+    }
 }
 
 extern int initilize_keyboard(){
@@ -46,10 +62,7 @@ extern int initilize_keyboard(){
         close(fd_k);
         return 1;
     }
-    ioctl(fd_k, UI_SET_EVBIT, EV_KEY);
-    for (int key = 1; key <= 248; key++) {
-        ioctl(fd_k, UI_SET_KEYBIT, key);
-    }
+    keyboard_setup_bits(fd_k);
     memset(&usetup, 0, sizeof(usetup));
     usetup.id.bustype = BUS_USB; 
     usetup.id.vendor = 0x1234;    
@@ -62,9 +75,14 @@ extern int initilize_keyboard(){
         return 1;
     }
     
+    DeviceWatch watch;
+    device_watch_start(&watch);
     if (ioctl(fd_k, UI_DEV_CREATE) < 0) {
         perror("ioctl dev create");
+        device_watch_stop(&watch);
         close(fd_k);
         return 1;
     }
+    device_wait_ready(fd_k, &watch);
+    return 0;
 }
\ No newline at end of file
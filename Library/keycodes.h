@@ -1,125 +1,5 @@
-typedef struct {
-    short winapi_code;
-    short linux_code;
-} KeyMapping;
-// Таблица соответствия кодов
-const KeyMapping key_mappings[] = {
-    // Буквенно-цифровые
-    { 0x41, 0x1E },  // A
-    { 0x42, 0x30 },  // B
-    { 0x43, 0x2E },  // C
-    { 0x44, 0x20 },  // D
-    { 0x45, 0x12 },  // E
-    { 0x46, 0x21 },  // F
-    { 0x47, 0x22 },  // G
-    { 0x48, 0x23 },  // H
-    { 0x49, 0x17 },  // I
-    { 0x4A, 0x24 },  // J
-    { 0x4B, 0x25 },  // K
-    { 0x4C, 0x26 },  // L
-    { 0x4D, 0x32 },  // M
-    { 0x4E, 0x31 },  // N
-    { 0x4F, 0x18 },  // O
-    { 0x50, 0x19 },  // P
-    { 0x51, 0x10 },  // Q
-    { 0x52, 0x13 },  // R
-    { 0x53, 0x1F },  // S
-    { 0x54, 0x14 },  // T
-    { 0x55, 0x16 },  // U
-    { 0x56, 0x2F },  // V
-    { 0x57, 0x11 },  // W
-    { 0x58, 0x2D },  // X
-    { 0x59, 0x15 },  // Y
-    { 0x5A, 0x2C },  // Z
-    
-    // Цифры
-    { 0x30, 0x0B },  // 0
-    { 0x31, 0x02 },  // 1
-    { 0x32, 0x03 },  // 2
-    { 0x33, 0x04 },  // 3
-    { 0x34, 0x05 },  // 4
-    { 0x35, 0x06 },  // 5
-    { 0x36, 0x07 },  // 6
-    { 0x37, 0x08 },  // 7
-    { 0x38, 0x09 },  // 8
-    { 0x39, 0x0A },  // 9
-    
-    // Функциональные клавиши
-    { 0x70, 0x3B },  // F1
-    { 0x71, 0x3C },  // F2
-    { 0x72, 0x3D },  // F3
-    { 0x73, 0x3E },  // F4
-    { 0x74, 0x3F },  // F5
-    { 0x75, 0x40 },  // F6
-    { 0x76, 0x41 },  // F7
-    { 0x77, 0x42 },  // F8
-    { 0x78, 0x43 },  // F9
-    { 0x79, 0x44 },  // F10
-    { 0x7A, 0x57 },  // F11
-    { 0x7B, 0x58 },  // F12
-    
-    // Управление
-    { 0x08, 0x0E },  // Backspace
-    { 0x09, 0x0F },  // Tab
-    { 0x0D, 0x1C },  // Enter
-    { 0xA0, 0x2A },  // Left Shift
-    { 0xA1, 0x36 },  // Right Shift
-    { 0xA2, 0x1D },  // Left Ctrl
-    { 0xA3, 0x61 },  // Right Ctrl
-    { 0xA4, 0x38 },  // Left Alt
-    { 0xA5, 0x64 },  // Right Alt
-    { 0x20, 0x39 },  // Space
-    { 0x14, 0x3A },  // Caps Lock
-    { 0x1B, 0x01 },  // Escape
-    
-    // Навигация
-    { 0x2D, 0x6E },  // Insert
-    { 0x2E, 0x6F },  // Delete
-    { 0x24, 0x66 },  // Home
-    { 0x23, 0x6B },  // End
-    { 0x21, 0x68 },  // Page Up
-    { 0x22, 0x6D },  // Page Down
-    { 0x25, 0x69 },  // Left Arrow
-    { 0x26, 0x67 },  // Up Arrow
-    { 0x27, 0x6A },  // Right Arrow
-    { 0x28, 0x6C },  // Down Arrow
-    
-    // Цифровой блок
-    { 0x90, 0x45 },  // Num Lock
-    { 0x60, 0x52 },  // Numpad 0
-    { 0x61, 0x4F },  // Numpad 1
-    { 0x62, 0x50 },  // Numpad 2
-    { 0x63, 0x51 },  // Numpad 3
-    { 0x64, 0x4B },  // Numpad 4
-    { 0x65, 0x4C },  // Numpad 5
-    { 0x66, 0x4D },  // Numpad 6
-    { 0x67, 0x47 },  // Numpad 7
-    { 0x68, 0x48 },  // Numpad 8
-    { 0x69, 0x49 },  // Numpad 9
-    { 0x6A, 0x37 },  // Numpad Multiply (*)
-    { 0x6B, 0x4E },  // Numpad Add (+)
-    { 0x6D, 0x4A },  // Numpad Subtract (-)
-    { 0x6E, 0x53 },  // Numpad Decimal (.)
-    { 0x6F, 0x62 },  // Numpad Divide (/)
-    
-    // Мультимедиа
-    { 0xAF, 0x73 },  // Volume Up
-    { 0xAE, 0x72 },  // Volume Down
-    { 0xAD, 0x71 },  // Volume Mute
-    { 0xB3, 0xA8 },  // Play/Pause
-    { 0xB2, 0x80 },  // Stop
-    { 0xB0, 0xA3 },  // Next Track
-    { 0xB1, 0xA5 },  // Prev Track
-};
+#include <linux/input-event-codes.h>
 
-short winapi_to_linux_key(short winapi_code) {
-    for (int i = 0; i < sizeof(key_mappings); i++) {
-        if (key_mappings[i].winapi_code == winapi_code) {
-            return key_mappings[i].linux_code;
-        }
-    }
-    return -1; // Код не найден
-}
 
 // Кнопки мыши (0x01-0x06)
 #define VK_LBUTTON        0x01  // Левая кнопка мыши
@@ -365,4 +245,163 @@ short winapi_to_linux_key(short winapi_code) {
 #define VK_ZOOM           0xFB  // Zoom
 #define VK_NONAME         0xFC  // Noname
 #define VK_PA1            0xFD  // PA1
-#define VK_OEM_CLEAR      0xFE  // Clear
\ No newline at end of file
+#define VK_OEM_CLEAR      0xFE  // Clear
+
+
+// Таблица соответствия кодов: X(VK_*, KEY_*) в обе стороны
+#define VK_KEY_MAPPINGS(X) \
+    /* Кнопки мыши */ \
+    X(VK_LBUTTON,   BTN_LEFT) \
+    X(VK_RBUTTON,   BTN_RIGHT) \
+    X(VK_MBUTTON,   BTN_MIDDLE) \
+    X(VK_XBUTTON1,  BTN_SIDE) \
+    X(VK_XBUTTON2,  BTN_EXTRA) \
+    /* Буквенно-цифровые */ \
+    X(VK_A, KEY_A) X(VK_B, KEY_B) X(VK_C, KEY_C) X(VK_D, KEY_D) \
+    X(VK_E, KEY_E) X(VK_F, KEY_F) X(VK_G, KEY_G) X(VK_H, KEY_H) \
+    X(VK_I, KEY_I) X(VK_J, KEY_J) X(VK_K, KEY_K) X(VK_L, KEY_L) \
+    X(VK_M, KEY_M) X(VK_N, KEY_N) X(VK_O, KEY_O) X(VK_P, KEY_P) \
+    X(VK_Q, KEY_Q) X(VK_R, KEY_R) X(VK_S, KEY_S) X(VK_T, KEY_T) \
+    X(VK_U, KEY_U) X(VK_V, KEY_V) X(VK_W, KEY_W) X(VK_X, KEY_X) \
+    X(VK_Y, KEY_Y) X(VK_Z, KEY_Z) \
+    /* Цифры */ \
+    X(VK_0, KEY_0) X(VK_1, KEY_1) X(VK_2, KEY_2) X(VK_3, KEY_3) \
+    X(VK_4, KEY_4) X(VK_5, KEY_5) X(VK_6, KEY_6) X(VK_7, KEY_7) \
+    X(VK_8, KEY_8) X(VK_9, KEY_9) \
+    /* Функциональные клавиши */ \
+    X(VK_F1, KEY_F1)   X(VK_F2, KEY_F2)   X(VK_F3, KEY_F3)   X(VK_F4, KEY_F4) \
+    X(VK_F5, KEY_F5)   X(VK_F6, KEY_F6)   X(VK_F7, KEY_F7)   X(VK_F8, KEY_F8) \
+    X(VK_F9, KEY_F9)   X(VK_F10, KEY_F10) X(VK_F11, KEY_F11) X(VK_F12, KEY_F12) \
+    X(VK_F13, KEY_F13) X(VK_F14, KEY_F14) X(VK_F15, KEY_F15) X(VK_F16, KEY_F16) \
+    X(VK_F17, KEY_F17) X(VK_F18, KEY_F18) X(VK_F19, KEY_F19) X(VK_F20, KEY_F20) \
+    X(VK_F21, KEY_F21) X(VK_F22, KEY_F22) X(VK_F23, KEY_F23) X(VK_F24, KEY_F24) \
+    /* Управление */ \
+    X(VK_BACK,      KEY_BACKSPACE) \
+    X(VK_TAB,       KEY_TAB) \
+    X(VK_CLEAR,     KEY_CLEAR) \
+    X(VK_RETURN,    KEY_ENTER) \
+    X(VK_LSHIFT,    KEY_LEFTSHIFT) \
+    X(VK_RSHIFT,    KEY_RIGHTSHIFT) \
+    X(VK_LCONTROL,  KEY_LEFTCTRL) \
+    X(VK_RCONTROL,  KEY_RIGHTCTRL) \
+    X(VK_LMENU,     KEY_LEFTALT) \
+    X(VK_RMENU,     KEY_RIGHTALT) \
+    X(VK_LWIN,      KEY_LEFTMETA) \
+    X(VK_RWIN,      KEY_RIGHTMETA) \
+    X(VK_APPS,      KEY_COMPOSE) \
+    X(VK_PAUSE,     KEY_PAUSE) \
+    X(VK_CAPITAL,   KEY_CAPSLOCK) \
+    X(VK_ESCAPE,    KEY_ESC) \
+    X(VK_SPACE,     KEY_SPACE) \
+    X(VK_SLEEP,     KEY_SLEEP) \
+    X(VK_HELP,      KEY_HELP) \
+    X(VK_SELECT,    KEY_SELECT) \
+    X(VK_PRINT,     KEY_PRINT) \
+    X(VK_SNAPSHOT,  KEY_SYSRQ) \
+    /* IME */ \
+    X(VK_KANA,       KEY_KATAKANAHIRAGANA) \
+    X(VK_HANJA,      KEY_HANJA) \
+    X(VK_CONVERT,    KEY_HENKAN) \
+    X(VK_NONCONVERT, KEY_MUHENKAN) \
+    /* Навигация */ \
+    X(VK_INSERT,    KEY_INSERT) \
+    X(VK_DELETE,    KEY_DELETE) \
+    X(VK_HOME,      KEY_HOME) \
+    X(VK_END,       KEY_END) \
+    X(VK_PRIOR,     KEY_PAGEUP) \
+    X(VK_NEXT,      KEY_PAGEDOWN) \
+    X(VK_LEFT,      KEY_LEFT) \
+    X(VK_UP,        KEY_UP) \
+    X(VK_RIGHT,     KEY_RIGHT) \
+    X(VK_DOWN,      KEY_DOWN) \
+    /* Цифровой блок */ \
+    X(VK_NUMLOCK,   KEY_NUMLOCK) \
+    X(VK_SCROLL,    KEY_SCROLLLOCK) \
+    X(VK_NUMPAD0,   KEY_KP0) X(VK_NUMPAD1, KEY_KP1) X(VK_NUMPAD2, KEY_KP2) \
+    X(VK_NUMPAD3,   KEY_KP3) X(VK_NUMPAD4, KEY_KP4) X(VK_NUMPAD5, KEY_KP5) \
+    X(VK_NUMPAD6,   KEY_KP6) X(VK_NUMPAD7, KEY_KP7) X(VK_NUMPAD8, KEY_KP8) \
+    X(VK_NUMPAD9,   KEY_KP9) \
+    X(VK_MULTIPLY,  KEY_KPASTERISK) \
+    X(VK_ADD,       KEY_KPPLUS) \
+    X(VK_SEPARATOR, KEY_KPCOMMA) \
+    X(VK_SUBTRACT,  KEY_KPMINUS) \
+    X(VK_DECIMAL,   KEY_KPDOT) \
+    X(VK_DIVIDE,    KEY_KPSLASH) \
+    /* OEM (раскладка US) */ \
+    X(VK_OEM_1,      KEY_SEMICOLON) \
+    X(VK_OEM_PLUS,   KEY_EQUAL) \
+    X(VK_OEM_COMMA,  KEY_COMMA) \
+    X(VK_OEM_MINUS,  KEY_MINUS) \
+    X(VK_OEM_PERIOD, KEY_DOT) \
+    X(VK_OEM_2,      KEY_SLASH) \
+    X(VK_OEM_3,      KEY_GRAVE) \
+    X(VK_OEM_4,      KEY_LEFTBRACE) \
+    X(VK_OEM_5,      KEY_BACKSLASH) \
+    X(VK_OEM_6,      KEY_RIGHTBRACE) \
+    X(VK_OEM_7,      KEY_APOSTROPHE) \
+    X(VK_OEM_102,    KEY_102ND) \
+    /* Мультимедиа */ \
+    X(VK_BROWSER_BACK,      KEY_BACK) \
+    X(VK_BROWSER_FORWARD,   KEY_FORWARD) \
+    X(VK_BROWSER_REFRESH,   KEY_REFRESH) \
+    X(VK_BROWSER_STOP,      KEY_STOP) \
+    X(VK_BROWSER_SEARCH,    KEY_SEARCH) \
+    X(VK_BROWSER_FAVORITES, KEY_BOOKMARKS) \
+    X(VK_BROWSER_HOME,      KEY_HOMEPAGE) \
+    X(VK_VOLUME_MUTE,       KEY_MUTE) \
+    X(VK_VOLUME_DOWN,       KEY_VOLUMEDOWN) \
+    X(VK_VOLUME_UP,         KEY_VOLUMEUP) \
+    X(VK_MEDIA_NEXT_TRACK,  KEY_NEXTSONG) \
+    X(VK_MEDIA_PREV_TRACK,  KEY_PREVIOUSSONG) \
+    X(VK_MEDIA_STOP,        KEY_STOPCD) \
+    X(VK_MEDIA_PLAY_PAUSE,  KEY_PLAYPAUSE) \
+    X(VK_LAUNCH_MAIL,       KEY_MAIL) \
+    X(VK_LAUNCH_MEDIA_SELECT, KEY_MEDIA) \
+    X(VK_LAUNCH_APP1,       KEY_COMPUTER) \
+    X(VK_LAUNCH_APP2,       KEY_CALC) \
+    X(VK_PLAY,              KEY_PLAY) \
+    X(VK_ZOOM,              KEY_ZOOM)
+
+// Обобщённые модификаторы: только VK -> KEY (обратно идут левые/правые версии)
+#define VK_KEY_FORWARD_ONLY(X) \
+    X(VK_SHIFT,     KEY_LEFTSHIFT) \
+    X(VK_CONTROL,   KEY_LEFTCTRL) \
+    X(VK_MENU,      KEY_LEFTALT)
+
+// Дополнительные evdev коды без собственного VK: только KEY -> VK
+#define VK_KEY_REVERSE_ONLY(X) \
+    X(VK_RETURN,    KEY_KPENTER)
+
+#define VK_KEY_FORWARD_ENTRY(vk, key) [vk] = key,
+#define VK_KEY_REVERSE_ENTRY(vk, key) [key] = vk,
+
+// VK -> KEY_*, 0 (KEY_RESERVED) для неизвестных кодов
+static const short vk_to_linux_key[256] = {
+    VK_KEY_MAPPINGS(VK_KEY_FORWARD_ENTRY)
+    VK_KEY_FORWARD_ONLY(VK_KEY_FORWARD_ENTRY)
+};
+
+// KEY_*/BTN_* -> VK, 0 для кодов без VK; покрывает весь диапазон evdev
+static const unsigned char linux_key_to_vk[KEY_CNT] = {
+    VK_KEY_MAPPINGS(VK_KEY_REVERSE_ENTRY)
+    VK_KEY_REVERSE_ONLY(VK_KEY_REVERSE_ENTRY)
+};
+
+short winapi_to_linux_key(short winapi_code) {
+    if (winapi_code < 0 || winapi_code > 0xFF || vk_to_linux_key[winapi_code] == 0) {
+        return -1; // Код не найден
+    }
+    return vk_to_linux_key[winapi_code];
+}
+
+// BTN_LEFT..BTN_TASK: VK_*BUTTON идут в виртуальную мышь, а не в клавиатуру
+static int linux_key_is_mouse_button(short linux_code) {
+    return linux_code >= BTN_MOUSE && linux_code < BTN_JOYSTICK;
+}
+
+short linux_to_winapi_key(short linux_code) {
+    if (linux_code < 0 || linux_code >= KEY_CNT || linux_key_to_vk[linux_code] == 0) {
+        return -1; // Код не найден
+    }
+    return linux_key_to_vk[linux_code];
+}
@@ -0,0 +1,202 @@
+// latency.h - input timestamps and injection-to-report latency histograms
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <linux/input.h>
+
+// log2 buckets in microseconds: bucket 0 is < 1 us, bucket i is
+// [2^(i-1), 2^i) us, the last one takes everything above ~4 s
+#define LATENCY_BUCKETS 24
+
+// an injected motion not reported within this long is forgotten
+#define LATENCY_PENDING_TIMEOUT_US 1000000
+
+typedef enum {
+    LATENCY_INJECT_TO_COMPOSITOR,  // our write until the compositor's event timestamp
+    LATENCY_COMPOSITOR_TO_CLIENT,  // compositor timestamp until our listener runs
+    LATENCY_INJECT_TO_CLIENT,      // our write until our listener runs
+    LATENCY_STAGES,
+} LatencyStage;
+
+static const char *latency_stage_names[] = {
+    "inject->compositor", "compositor->client", "inject->client",
+};
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint64_t buckets[LATENCY_BUCKETS];
+} LatencyStats;
+
+typedef struct {
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum_us;
+    _Atomic uint64_t max_us;
+    _Atomic uint64_t buckets[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+LatencyHistogram latency_histograms[LATENCY_STAGES];
+
+// CLOCK_MONOTONIC write time of the oldest injected motion the compositor
+// has not reported back yet, 0 when none is pending
+_Atomic uint64_t latency_injected_us = 0;
+
+// CLOCK_MONOTONIC time of the newest observed key, button or pointer event
+_Atomic uint64_t last_message_time_us = 0;
+
+static uint64_t latency_now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void latency_record(LatencyStage stage, uint64_t us) {
+    LatencyHistogram *h = &latency_histograms[stage];
+    int bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+    if (bucket >= LATENCY_BUCKETS) bucket = LATENCY_BUCKETS - 1;
+    atomic_fetch_add_explicit(&h->buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum_us, us, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&h->max_us, memory_order_relaxed);
+    while (us > max && !atomic_compare_exchange_weak_explicit(&h->max_us, &max, us,
+                            memory_order_relaxed, memory_order_relaxed)) {
+    }
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_release);
+}
+
+// observed events: time_us must be CLOCK_MONOTONIC, as libinput and
+// wayland compositors report it
+static void latency_observed(uint64_t time_us) {
+    atomic_store_explicit(&last_message_time_us, time_us, memory_order_relaxed);
+}
+
+// Wayland event times are CLOCK_MONOTONIC milliseconds cut to 32 bits;
+// the high bits are taken from now. A time slightly ahead of now (or from
+// another clock base) is clamped to now rather than wrapped.
+static uint64_t latency_widen_ms(uint32_t ms, uint64_t now_us) {
+    uint64_t now_ms = now_us / 1000;
+    uint64_t event_ms = (now_ms & ~(uint64_t)0xffffffff) | ms;
+    if (event_ms > now_ms) {
+        bool wrapped = event_ms - now_ms > ((uint64_t)1 << 31);
+        if (wrapped && now_ms >= ((uint64_t)1 << 32)) {
+            event_ms -= (uint64_t)1 << 32;
+        } else {
+            event_ms = now_ms;
+        }
+    }
+    return event_ms * 1000;
+}
+
+static void latency_observed_ms(uint32_t ms) {
+    latency_observed(latency_widen_ms(ms, latency_now_us()));
+}
+
+// Stamps a run of injected events with the write time and remembers it
+// when the run moves the pointer. uinput replaces the stamp with its own,
+// the recording backend keeps it.
+static void latency_stamp_injected(struct input_event *events, size_t count) {
+    uint64_t now = latency_now_us();
+    bool motion = false;
+    for (size_t i = 0; i < count; i++) {
+        events[i].time.tv_sec = now / 1000000;
+        events[i].time.tv_usec = now % 1000000;
+        motion |= events[i].type == EV_REL &&
+                  (events[i].code == REL_X || events[i].code == REL_Y);
+        motion |= events[i].type == EV_ABS &&
+                  (events[i].code == ABS_X || events[i].code == ABS_Y);
+    }
+    if (motion) {
+        uint64_t none = 0;
+        atomic_compare_exchange_strong_explicit(&latency_injected_us, &none, now,
+                                                memory_order_relaxed, memory_order_relaxed);
+    }
+}
+
+// Called when the compositor reports pointer motion. compositor_ms is the
+// event's 32-bit millisecond timestamp; the split at the compositor is
+// only as precise as that millisecond.
+static void latency_observe_motion(uint32_t compositor_ms) {
+    uint64_t now = latency_now_us();
+    uint64_t event_us = latency_widen_ms(compositor_ms, now);
+    // other clock domain or bogus, don't split at the compositor
+    bool comparable = now - event_us < LATENCY_PENDING_TIMEOUT_US;
+    latency_observed(comparable ? event_us : now);
+    if (comparable) latency_record(LATENCY_COMPOSITOR_TO_CLIENT, now - event_us);
+
+    uint64_t injected = atomic_exchange_explicit(&latency_injected_us, 0, memory_order_relaxed);
+    if (injected == 0 || now - injected > LATENCY_PENDING_TIMEOUT_US) return;
+    latency_record(LATENCY_INJECT_TO_CLIENT, now - injected);
+    if (comparable && event_us + 1000 > injected) {
+        // the event millisecond may start just before the write
+        latency_record(LATENCY_INJECT_TO_COMPOSITOR, event_us > injected ? event_us - injected : 0);
+    }
+}
+
+// Milliseconds (CLOCK_MONOTONIC, wrapping like the Windows tick count) of
+// the newest key, button or pointer event observed.
+extern long GetMessageTime() {
+    return (long)(int32_t)(atomic_load_explicit(&last_message_time_us, memory_order_relaxed) / 1000);
+}
+
+extern uint64_t GetMessageTimeUsec() {
+    return atomic_load_explicit(&last_message_time_us, memory_order_relaxed);
+}
+
+extern bool GetLatencyStats(int stage, LatencyStats *stats) {
+    if (stage < 0 || stage >= LATENCY_STAGES || stats == NULL) return 0;
+    LatencyHistogram *h = &latency_histograms[stage];
+    stats->count = atomic_load_explicit(&h->count, memory_order_acquire);
+    stats->sum_us = atomic_load_explicit(&h->sum_us, memory_order_relaxed);
+    stats->max_us = atomic_load_explicit(&h->max_us, memory_order_relaxed);
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        stats->buckets[i] = atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+    }
+    return 1;
+}
+
+// upper bound in microseconds of the bucket holding the p-th sample
+static uint64_t latency_percentile_us(const LatencyStats *stats, double p) {
+    uint64_t total = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) total += stats->buckets[i];
+    if (total == 0) return 0;
+    uint64_t target = (uint64_t)(p * (total - 1));
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += stats->buckets[i];
+        if (seen > target) return (uint64_t)1 << i;
+    }
+    return stats->max_us;
+}
+
+extern void ResetLatencyStats() {
+    for (int stage = 0; stage < LATENCY_STAGES; stage++) {
+        LatencyHistogram *h = &latency_histograms[stage];
+        atomic_store(&h->count, 0);
+        atomic_store(&h->sum_us, 0);
+        atomic_store(&h->max_us, 0);
+        for (int i = 0; i < LATENCY_BUCKETS; i++) atomic_store(&h->buckets[i], 0);
+    }
+    atomic_store(&latency_injected_us, 0);
+}
+
+// one line per stage: count, mean, p50/p99 bucket bounds and max
+extern void PrintLatencyStats(FILE *out) {
+    for (int stage = 0; stage < LATENCY_STAGES; stage++) {
+        LatencyStats stats;
+        GetLatencyStats(stage, &stats);
+        fprintf(out, "%-20s n %8lu  mean %8.1f us  p50 <%8lu us  p99 <%8lu us  max %8lu us\n",
+                latency_stage_names[stage], (unsigned long)stats.count,
+                stats.count ? (double)stats.sum_us / stats.count : 0.0,
+                (unsigned long)latency_percentile_us(&stats, 0.50),
+                (unsigned long)latency_percentile_us(&stats, 0.99),
+                (unsigned long)stats.max_us);
+    }
+}
+
+#endif
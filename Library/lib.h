@@ -5,91 +5,283 @@
 #include <unistd.h>
 #include "absMove.h"
 #include "keyboard.h"
+#include "compositeDevice.h"
 //#include "structures.h"
 #include "getKeyState.h"
+#include "eventBatch.h"
+#include "injector.h"
+#include "eventLoop.h"
+#include "evdevKeys.h"
+#include "virtualPointerBackend.h"
+#include "log.h"
+#include "trace.h"
+
+// wall time of the last MAIN_INIT in milliseconds
+double init_time_ms = 0;
 
 extern void MAIN_INIT(){
-    init_tablet();
+    struct timespec init_start, init_end;
+    clock_gettime(CLOCK_MONOTONIC, &init_start);
+    // outputs first: the tablet's ABS range is sized from them
     init_layer_shell();
-    init_virtual_mouse();
-    initilize_keyboard();
-    init_libinput();
-    pthread_t check_buttons_thread;
-    pthread_t cursor_pos_thread;
-    pthread_create(&cursor_pos_thread, NULL, update_cursor_pos, NULL); 
-    pthread_create(&check_buttons_thread, NULL, check_buttons, NULL);
-    
+    if (composite_device){
+        init_composite_device();
+    } else {
+        init_tablet();
+        init_virtual_mouse();
+        initilize_keyboard();
+    }
+    // wayland and the key reader share one epoll thread instead of one thread each
+    if (raw_key_state){
+        init_evdev_keys();
+    } else if (init_libinput() == 0){
+        event_loop_add_fd(fd_linp, EPOLLIN, libinput_readable, NULL);
+    }
+    start_event_loop(display);
+    if (async_input){
+        start_injector();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &init_end);
+    init_time_ms = (init_end.tv_sec - init_start.tv_sec) * 1000.0 +
+                   (init_end.tv_nsec - init_start.tv_nsec) / 1000000.0;
+    LOG_DEBUG("MAIN_INIT took %.1f ms\n", init_time_ms);
+
 }
 extern void MAIN_DESTROY(){
-    destroy_tablet();
-    destroy_layer_shell();
-    destroy_virtual_mouse();
-    destroy_keyboard();
-    destroy_libinput();
+    stop_event_loop();
+    stop_hooks();
+    stop_injector();
+    if (composite_device){
+        destroy_composite_device();
+        destroy_layer_shell();
+    } else {
+        destroy_tablet();
+        destroy_layer_shell();
+        destroy_virtual_mouse();
+        destroy_keyboard();
+    }
+    if (raw_key_state){
+        destroy_evdev_keys();
+    } else {
+        destroy_libinput();
+    }
+}
+
+// Routes all injection into the in-memory recorder (see GetRecordedEvents).
+// Devices that were never created get /dev/null placeholders so the
+// injection paths accept them without root or /dev/uinput.
+extern void UseRecordingBackend(){
+    if (tablet.fd < 0) tablet.fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (fd < 0) fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (fd_k < 0) fd_k = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    SetOutputBackend(&recording_backend.base);
 }
 
 extern bool GetCursorPos(POINT *point){
-    (*point).x = cursor_x;
-    (*point).y = cursor_y;
+    CursorSample sample;
+    read_cursor_sample(&sample);
+    (*point).x = sample.x;
+    (*point).y = sample.y;
     return 1;
 }
 
-extern UINT SendInput(UINT cInputs, INPUT inputs[], int cbSize){
-    for (int i = 0; i < cInputs; i++){
-        INPUT input = inputs[i];
-        switch (input.type){
-            case (0):
-                switch (input.mi.dwFlags){
-                    case (MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE):
-                        SetCursorPos(input.mi.dx, input.mi.dy);
-                        break;
-                    case (MOUSEEVENTF_MOVE):
-                        mouseMove(input.mi.dx, input.mi.dy);
-                        break;
-                    case (MOUSEEVENTF_LEFTDOWN):
-                        emit_mouse(EV_KEY, BTN_LEFT, 1);
-                        sync_mouse();
-                        break;
-                    case (MOUSEEVENTF_LEFTUP):
-                        emit_mouse(EV_KEY, BTN_LEFT, 0);
-                        sync_mouse();
-                        break;
-                    case (MOUSEEVENTF_RIGHTDOWN):
-                        emit_mouse(EV_KEY, BTN_RIGHT, 1);
-                        sync_mouse();
-                        break;
-                    case (MOUSEEVENTF_RIGHTUP):
-                        emit_mouse(EV_KEY, BTN_RIGHT, 0);
-                        sync_mouse();
-                        break;
-                    case (MOUSEEVENTF_WHEEL):
-                        emit_mouse(EV_REL, REL_WHEEL, input.mi.mouseData);
-                        sync_mouse();
-                        break;
-                    case (MOUSEEVENTF_HWHEEL):
-                        emit_mouse(EV_REL, REL_HWHEEL, input.mi.mouseData);
-                        sync_mouse();
-                        break;
-                    
-                }
-                
-                break;
-                
-            case (1):
-                bool is_pressed = 0;
-                if (input.ki.dwFlags == NULL){
-                    is_pressed = 1;
+// GetCursorPos plus the wayland timestamp and sequence number of the sample,
+// so pollers can tell new positions from repeated ones.
+extern bool GetCursorSample(CursorSample *sample){
+    read_cursor_sample(sample);
+    return sample->sequence != 0;
+}
+
+// Like WaitForCursorMove but returns as soon as any sample newer than
+// after_sequence exists, so a caller cannot miss a move between two waits.
+extern bool WaitForCursorSample(uint64_t after_sequence, DWORD dwMilliseconds, CursorSample *sample){
+    int64_t timeout = dwMilliseconds == INFINITE ? -1 : (int64_t)dwMilliseconds;
+    return wait_cursor_sample(after_sequence, timeout, sample);
+}
+
+// Sleeps until the cursor moves or dwMilliseconds pass (INFINITE waits forever).
+// Returns 0 on timeout; otherwise point holds the new position.
+extern bool WaitForCursorMove(DWORD dwMilliseconds, POINT *point){
+    CursorSample sample;
+    read_cursor_sample(&sample);
+    if (!WaitForCursorSample(sample.sequence, dwMilliseconds, &sample)){
+        return 0;
+    }
+    (*point).x = sample.x;
+    (*point).y = sample.y;
+    return 1;
+}
+
+// Copies up to nBufPoints (at most 64) earlier positions into lpptBuf, newest
+// first, starting at the one matching lppt (its time too, unless 0).
+// Returns the number copied, or -1 if lppt is not in the history.
+// Only display points exist here, both resolutions return the same.
+extern int GetMouseMovePointsEx(UINT cbSize, LPMOUSEMOVEPOINT lppt, LPMOUSEMOVEPOINT lpptBuf, int nBufPoints, DWORD resolution){
+    if (cbSize != sizeof(MOUSEMOVEPOINT) || lppt == NULL || nBufPoints < 0 || nBufPoints > 64){
+        return -1;
+    }
+    CursorSample history[MOTION_HISTORY_SIZE];
+    int count = read_motion_history(history, MOTION_HISTORY_SIZE);
+    for (int start = 0; start < count; start++){
+        if (history[start].x != lppt->x || history[start].y != lppt->y) continue;
+        if (lppt->time != 0 && history[start].time != lppt->time) continue;
+        int copied = 0;
+        for (int i = start; i < count && copied < nBufPoints; i++){
+            lpptBuf[copied].x = history[i].x;
+            lpptBuf[copied].y = history[i].y;
+            lpptBuf[copied].time = history[i].time;
+            lpptBuf[copied].dwExtraInfo = 0;
+            copied++;
+        }
+        return copied;
+    }
+    return -1;
+}
+
+// Served from the geometry cached on output changes, no round trip.
+// Unknown indices return 0 like on Windows.
+extern int GetSystemMetrics(int nIndex){
+    ScreenMetrics metrics;
+    read_screen_metrics(&metrics);
+    switch (nIndex){
+        case SM_CXSCREEN: return metrics.primary_width;
+        case SM_CYSCREEN: return metrics.primary_height;
+        case SM_XVIRTUALSCREEN: return metrics.virtual_x;
+        case SM_YVIRTUALSCREEN: return metrics.virtual_y;
+        case SM_CXVIRTUALSCREEN: return metrics.virtual_width;
+        case SM_CYVIRTUALSCREEN: return metrics.virtual_height;
+        case SM_CMONITORS: return metrics.monitors;
+    }
+    return 0;
+}
+
+// callback runs on the wayland thread for every cursor position; keep it short
+extern int RegisterCursorCallback(CursorCallback callback, void *user_data){
+    return register_cursor_callback(callback, user_data);
+}
+
+// returns once the callback is no longer running
+extern void UnregisterCursorCallback(int handle){
+    unregister_cursor_callback(handle);
+}
+
+// Translates one INPUT into the frame for its target device.
+// Returns -1 for an unsupported input type; an empty frame means nothing to send.
+static int translate_input(const INPUT *input, InputFrame *frame){
+    switch (input->type){
+        case (INPUT_MOUSE):
+            if (input->mi.dwFlags == (MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE)){
+                frame_init(frame, tablet.fd);
+                int abs_x, abs_y;
+                if (!tablet_map_point(input->mi.dx, input->mi.dy, &abs_x, &abs_y)){
+                    return 0;
                 }
-                printf("Pressing");
-                emit(EV_KEY, winapi_to_linux_key(input.ki.wVk), is_pressed);
-                break;
-            default:
-                return 1;
+                frame_add(frame, EV_ABS, ABS_X, abs_x);
+                frame_add(frame, EV_ABS, ABS_Y, abs_y);
+                tablet.last_x = input->mi.dx;
+                tablet.last_y = input->mi.dy;
+                return 0;
+            }
+            frame_init(frame, fd);
+            switch (input->mi.dwFlags){
+                case (MOUSEEVENTF_MOVE):
+                    frame_add(frame, EV_REL, REL_X, input->mi.dx);
+                    frame_add(frame, EV_REL, REL_Y, input->mi.dy);
+                    break;
+                case (MOUSEEVENTF_LEFTDOWN):
+                    frame_add(frame, EV_KEY, BTN_LEFT, 1);
+                    break;
+                case (MOUSEEVENTF_LEFTUP):
+                    frame_add(frame, EV_KEY, BTN_LEFT, 0);
+                    break;
+                case (MOUSEEVENTF_RIGHTDOWN):
+                    frame_add(frame, EV_KEY, BTN_RIGHT, 1);
+                    break;
+                case (MOUSEEVENTF_RIGHTUP):
+                    frame_add(frame, EV_KEY, BTN_RIGHT, 0);
+                    break;
+                case (MOUSEEVENTF_WHEEL):
+                    frame_add(frame, EV_REL, REL_WHEEL, input->mi.mouseData);
+                    break;
+                case (MOUSEEVENTF_HWHEEL):
+                    frame_add(frame, EV_REL, REL_HWHEEL, input->mi.mouseData);
+                    break;
+            }
+            return 0;
+
+        case (INPUT_KEYBOARD):
+            frame_init(frame, fd_k);
+            bool is_pressed = 0;
+            if (input->ki.dwFlags == NULL){
+                is_pressed = 1;
+            }
+            LOG_DEBUG("Pressing %d\n", input->ki.wVk);
+            TRACE(TRACE_KEY, input->ki.wVk, is_pressed, 0);
+            short key = winapi_to_linux_key(input->ki.wVk);
+            if (key < 0){
+                return 0;
+            }
+            // VK_LBUTTON and friends only exist on the mouse
+            if (linux_key_is_mouse_button(key)){
+                frame_init(frame, fd);
+            }
+            frame_add(frame, EV_KEY, key, is_pressed);
+            return 0;
 
+        default:
+            return -1;
+    }
+}
+
+// Async path: the whole call is reserved as one contiguous run of queue slots
+// (chunked if it exceeds the queue) so it is not interleaved with other callers.
+static UINT queue_inputs(UINT cInputs, INPUT inputs[]){
+    UINT done = 0;
+    while (done < cInputs){
+        size_t n = cInputs - done;
+        if (n > INJECT_QUEUE_SIZE) n = INJECT_QUEUE_SIZE;
+        size_t pos = injector_reserve(n);
+        UINT result = 0;
+        for (size_t i = 0; i < n; i++){
+            InputFrame *frame = injector_frame(pos + i);
+            if (result == 0 && translate_input(&inputs[done + i], frame) < 0){
+                result = 1;
+            }
+            if (result != 0){
+                // slots are already reserved, publish them empty
+                frame_init(frame, -1);
+            }
         }
+        injector_publish(pos, n);
+        if (result != 0) return result;
+        done += n;
     }
     return 0;
 }
+
+extern UINT SendInput(UINT cInputs, INPUT inputs[], int cbSize){
+    TRACE(TRACE_SEND_INPUT, cInputs, injector_active(), 0);
+    if (injector_enter()){
+        UINT result = queue_inputs(cInputs, inputs);
+        injector_leave();
+        return result;
+    }
+
+    EventBatch batch;
+    batch_init(&batch, -1);
+    UINT result = 0;
+    for (int i = 0; i < cInputs; i++){
+        InputFrame frame;
+        if (translate_input(&inputs[i], &frame) < 0){
+            result = 1;
+            break;
+        }
+        // a device switch flushes, so the caller's cross-device order holds
+        batch_frame(&batch, &frame);
+    }
+    batch_flush(&batch);
+    return result;
+}
 void GetSystemTime(SYSTEMTIME *lpSystemTime){
     time_t rawtime;
     time(&rawtime);
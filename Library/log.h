@@ -0,0 +1,22 @@
+// log.h - compile-time gated logging
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdio.h>
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_DEBUG 3
+
+// Build with -DLOG_LEVEL=LOG_LEVEL_DEBUG to get the per-call messages of the
+// injection paths back; below that level they are compiled out entirely.
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_ERROR(...) do { if (LOG_LEVEL >= LOG_LEVEL_ERROR) fprintf(stderr, __VA_ARGS__); } while (0)
+#define LOG_INFO(...)  do { if (LOG_LEVEL >= LOG_LEVEL_INFO) printf(__VA_ARGS__); } while (0)
+#define LOG_DEBUG(...) do { if (LOG_LEVEL >= LOG_LEVEL_DEBUG) printf(__VA_ARGS__); } while (0)
+
+#endif
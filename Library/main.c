@@ -3,39 +3,91 @@
 
 
 
-void* restrict_cursor(void* arg){
+RECT clip_rect;
+int clip_callback = -1;
+
+// Without the injector SetCursorPos sleeps in send_absolute, which must
+// not happen on the event loop thread. Corrections then go to this thread
+// instead; only the newest one matters, so it is a single slot.
+struct {
+    _Atomic uint64_t target;  // x in the high half, y in the low half
+    int wake_fd;
+    pthread_t thread;
+} clip_worker = { .wake_fd = -1 };
+
+static void *clip_worker_thread(void *arg){
+    uint64_t count;
+    while (read(clip_worker.wake_fd, &count, sizeof(count)) == sizeof(count)){
+        uint64_t target = atomic_load(&clip_worker.target);
+        SetCursorPos((int32_t)(target >> 32), (int32_t)target);
+    }
+    return NULL;
+}
+
+static int start_clip_worker(){
+    if (clip_worker.wake_fd >= 0) return 0;
+    clip_worker.wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (clip_worker.wake_fd < 0){
+        perror("eventfd");
+        return -1;
+    }
+    if (pthread_create(&clip_worker.thread, NULL, clip_worker_thread, NULL) != 0){
+        fprintf(stderr, "Failed to start clip thread\n");
+        close(clip_worker.wake_fd);
+        clip_worker.wake_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+static void move_cursor_async(int x, int y){
+    if (injector_active() || clip_worker.wake_fd < 0){
+        SetCursorPos(x, y);
+        return;
+    }
+    atomic_store(&clip_worker.target, ((uint64_t)(uint32_t)x << 32) | (uint32_t)y);
+    uint64_t one = 1;
+    write(clip_worker.wake_fd, &one, sizeof(one));
+}
+
+// runs on the event loop thread for every cursor position
+static void restrict_cursor(const CursorSample *sample, void *arg){
     RECT* rect  = (RECT*) arg;
-    int right = rect -> right;
-    int left = rect -> left;
-    int bottom = rect -> bottom;
-    int top = (*rect).top;
-    printf("top: %d \n", rect->top);
-    while (true){
-        if (cursor_x > right){
-            SetCursorPos(right, cursor_y);
-            printf("right \n");
-        }
-        if (cursor_x < left){
-            SetCursorPos(left, cursor_y);
-            printf("left \n");
-        }
-        if (cursor_y < top){
-            SetCursorPos(cursor_x, top);
-            printf("top \n");
-        }
-        if (cursor_y > bottom){
-            SetCursorPos(cursor_x, bottom);
-            printf("bottom \n");
-        }
+    int x = sample->x, y = sample->y;
+    if (x > rect->right){
+        x = rect->right;
+        LOG_DEBUG("right \n");
+        TRACE(TRACE_CLIP_CORRECTION, sample->x, sample->y, rect->right);
+    }
+    if (x < rect->left){
+        x = rect->left;
+        LOG_DEBUG("left \n");
+        TRACE(TRACE_CLIP_CORRECTION, sample->x, sample->y, rect->left);
+    }
+    if (y < rect->top){
+        y = rect->top;
+        LOG_DEBUG("top \n");
+        TRACE(TRACE_CLIP_CORRECTION, sample->x, sample->y, rect->top);
+    }
+    if (y > rect->bottom){
+        y = rect->bottom;
+        LOG_DEBUG("bottom \n");
+        TRACE(TRACE_CLIP_CORRECTION, sample->x, sample->y, rect->bottom);
+    }
+    if (x != sample->x || y != sample->y){
+        move_cursor_async(x, y);
     }
 }
 
 bool ClipCursor(RECT rect){
-    printf("top1: %d \n", rect.top);
-    RECT copy = rect;
-    pthread_t clip_cursor_thread;
-    pthread_create(&clip_cursor_thread, NULL, restrict_cursor, &copy);
-    sleep(1);
+    LOG_DEBUG("top1: %d \n", rect.top);
+    if (clip_callback >= 0){
+        UnregisterCursorCallback(clip_callback);
+    }
+    start_clip_worker();
+    // unregistering waited for a running restrict_cursor, nothing reads it now
+    clip_rect = rect;
+    clip_callback = RegisterCursorCallback(restrict_cursor, &clip_rect);
     return 0;
 }
 
@@ -0,0 +1,133 @@
+// outputBackend.h - where injected input_events end up
+#ifndef OUTPUT_BACKEND_H
+#define OUTPUT_BACKEND_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <linux/input.h>
+#include "latency.h"
+
+// A backend receives whole runs of events for one device handle (tablet.fd,
+// fd or fd_k). Runs always end on a SYN_REPORT except when a batch fills up.
+typedef struct OutputBackend {
+    const char *name;
+    int (*write_events)(struct OutputBackend *backend, int device,
+                        const struct input_event *events, size_t count);
+} OutputBackend;
+
+// uinput: the device handle is the uinput fd itself.
+static int uinput_write_events(OutputBackend *backend, int device,
+                               const struct input_event *events, size_t count) {
+    const char *data = (const char *)events;
+    size_t left = count * sizeof(struct input_event);
+
+    if (device < 0) return -1;
+    while (left > 0) {
+        ssize_t written = write(device, data, left);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            perror("write event batch");
+            return -1;
+        }
+        data += written;
+        left -= written;
+    }
+    return 0;
+}
+
+OutputBackend uinput_backend = { .name = "uinput", .write_events = uinput_write_events };
+
+OutputBackend *output_backend = &uinput_backend;
+
+// Every injection path funnels through here, so this is where injected
+// events get their timestamp.
+static int output_write(int device, struct input_event *events, size_t count) {
+    if (count == 0) return 0;
+    latency_stamp_injected(events, count);
+    return output_backend->write_events(output_backend, device, events, count);
+}
+
+extern void SetOutputBackend(OutputBackend *backend) {
+    output_backend = backend ? backend : &uinput_backend;
+}
+
+// Recording: keeps the exact event stream in memory, tagged with the device
+// handle it was sent to, so the translation layer can be checked without root.
+typedef struct {
+    int device;
+    struct input_event event;
+} RecordedEvent;
+
+typedef struct {
+    OutputBackend base;
+    pthread_mutex_t lock;
+    RecordedEvent *events;
+    size_t count;
+    size_t capacity;
+} RecordingBackend;
+
+static int recording_write_events(OutputBackend *backend, int device,
+                                  const struct input_event *events, size_t count) {
+    RecordingBackend *rec = (RecordingBackend *)backend;
+
+    pthread_mutex_lock(&rec->lock);
+    if (rec->count + count > rec->capacity) {
+        size_t capacity = rec->capacity ? rec->capacity : 1024;
+        while (capacity < rec->count + count) capacity *= 2;
+        RecordedEvent *grown = realloc(rec->events, capacity * sizeof(RecordedEvent));
+        if (!grown) {
+            pthread_mutex_unlock(&rec->lock);
+            return -1;
+        }
+        rec->events = grown;
+        rec->capacity = capacity;
+    }
+    for (size_t i = 0; i < count; i++) {
+        rec->events[rec->count].device = device;
+        rec->events[rec->count].event = events[i];
+        rec->count++;
+    }
+    pthread_mutex_unlock(&rec->lock);
+    return 0;
+}
+
+RecordingBackend recording_backend = {
+    .base = { .name = "recording", .write_events = recording_write_events },
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+// Copies up to max recorded events into out and returns how many were copied.
+extern size_t GetRecordedEvents(RecordedEvent *out, size_t max) {
+    pthread_mutex_lock(&recording_backend.lock);
+    size_t count = recording_backend.count < max ? recording_backend.count : max;
+    memcpy(out, recording_backend.events, count * sizeof(RecordedEvent));
+    pthread_mutex_unlock(&recording_backend.lock);
+    return count;
+}
+
+extern void ClearRecordedEvents() {
+    pthread_mutex_lock(&recording_backend.lock);
+    recording_backend.count = 0;
+    pthread_mutex_unlock(&recording_backend.lock);
+}
+
+// Writes the raw input_event stream recorded for one device (or all, with -1)
+// to out_fd, e.g. a memfd, in the same format uinput would have received.
+extern int DumpRecordedEvents(int out_fd, int device) {
+    int result = 0;
+    pthread_mutex_lock(&recording_backend.lock);
+    for (size_t i = 0; i < recording_backend.count && result == 0; i++) {
+        if (device >= 0 && recording_backend.events[i].device != device) continue;
+        result = uinput_write_events(&uinput_backend, out_fd,
+                                     &recording_backend.events[i].event, 1);
+    }
+    pthread_mutex_unlock(&recording_backend.lock);
+    return result;
+}
+
+#endif
@@ -0,0 +1,117 @@
+// raster.h - span filling for the overlay highlight
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// half-open pixel rectangle, empty when x0 >= x1 or y0 >= y1
+typedef struct {
+    int x0, y0;
+    int x1, y1;
+} PixelRect;
+
+static bool rect_empty(PixelRect r) {
+    return r.x0 >= r.x1 || r.y0 >= r.y1;
+}
+
+static PixelRect rect_union(PixelRect a, PixelRect b) {
+    if (rect_empty(a)) return b;
+    if (rect_empty(b)) return a;
+    PixelRect r = {
+        a.x0 < b.x0 ? a.x0 : b.x0, a.y0 < b.y0 ? a.y0 : b.y0,
+        a.x1 > b.x1 ? a.x1 : b.x1, a.y1 > b.y1 ? a.y1 : b.y1,
+    };
+    return r;
+}
+
+static PixelRect rect_clip(PixelRect r, int width, int height) {
+    if (r.x0 < 0) r.x0 = 0;
+    if (r.y0 < 0) r.y0 = 0;
+    if (r.x1 > width) r.x1 = width;
+    if (r.y1 > height) r.y1 = height;
+    if (rect_empty(r)) r.x0 = r.y0 = r.x1 = r.y1 = 0;
+    return r;
+}
+
+// floor(sqrt(n)), bit by bit so the library needs no libm
+static uint32_t isqrt(uint32_t n) {
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > n) bit >>= 2;
+    while (bit != 0) {
+        if (n >= root + bit) {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+// 16-byte stores for the bulk of the span, scalar head and tail
+static void fill_span(uint32_t *dst, uint32_t value, int count) {
+    int i = 0;
+#ifdef __SSE2__
+    while (i < count && ((uintptr_t)(dst + i) & 15) != 0) {
+        dst[i++] = value;
+    }
+    __m128i v = _mm_set1_epi32((int)value);
+    for (; i + 16 <= count; i += 16) {
+        _mm_store_si128((__m128i *)(dst + i), v);
+        _mm_store_si128((__m128i *)(dst + i + 4), v);
+        _mm_store_si128((__m128i *)(dst + i + 8), v);
+        _mm_store_si128((__m128i *)(dst + i + 12), v);
+    }
+    for (; i + 4 <= count; i += 4) {
+        _mm_store_si128((__m128i *)(dst + i), v);
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = value;
+    }
+}
+
+static void clear_rect(uint32_t *pixels, int stride_px, PixelRect r) {
+    if (rect_empty(r)) return;
+    size_t bytes = (size_t)(r.x1 - r.x0) * sizeof(uint32_t);
+    for (int y = r.y0; y < r.y1; y++) {
+        memset(pixels + (size_t)y * stride_px + r.x0, 0, bytes);
+    }
+}
+
+// Fills every pixel with dx*dx + dy*dy <= radius*radius, one span per
+// scanline, clipped to width x height. Returns the rectangle touched.
+static PixelRect fill_circle(uint32_t *pixels, int width, int height,
+                             int center_x, int center_y, int radius, uint32_t value) {
+    PixelRect touched = { 0, 0, 0, 0 };
+    if (radius < 0) return touched;
+
+    PixelRect box = { center_x - radius, center_y - radius,
+                      center_x + radius + 1, center_y + radius + 1 };
+    box = rect_clip(box, width, height);
+    if (rect_empty(box)) return touched;
+
+    uint32_t radius_squared = (uint32_t)radius * (uint32_t)radius;
+    for (int y = box.y0; y < box.y1; y++) {
+        int dy = y - center_y;
+        int half = (int)isqrt(radius_squared - (uint32_t)(dy * dy));
+        int x0 = center_x - half;
+        int x1 = center_x + half + 1;
+        if (x0 < 0) x0 = 0;
+        if (x1 > width) x1 = width;
+        if (x0 >= x1) continue;
+        fill_span(pixels + (size_t)y * width + x0, value, x1 - x0);
+        PixelRect span = { x0, y, x1, y + 1 };
+        touched = rect_union(touched, span);
+    }
+    return touched;
+}
+
+#endif
@@ -7,10 +7,30 @@
 #include <string.h>
 #include <errno.h>
 #include <time.h>
+#include "injector.h"
+#include "deviceReady.h"
+#include "log.h"
+#include "trace.h"
 
-int fd;
+int fd = -1;
 struct input_event ev;
 
+// registers the mouse buttons and relative axes on dev_fd before UI_DEV_SETUP
+static void mouse_setup_bits(int dev_fd) {
+    ioctl(dev_fd, UI_SET_EVBIT, EV_KEY);
+    ioctl(dev_fd, UI_SET_KEYBIT, BTN_LEFT);
+    ioctl(dev_fd, UI_SET_KEYBIT, BTN_RIGHT);
+    ioctl(dev_fd, UI_SET_KEYBIT, BTN_MIDDLE);
+    ioctl(dev_fd, UI_SET_KEYBIT, BTN_SIDE);   // VK_XBUTTON1
+    ioctl(dev_fd, UI_SET_KEYBIT, BTN_EXTRA);  // VK_XBUTTON2
+    
+    ioctl(dev_fd, UI_SET_EVBIT, EV_REL);
+    ioctl(dev_fd, UI_SET_RELBIT, REL_X);
+    ioctl(dev_fd, UI_SET_RELBIT, REL_Y);
+    ioctl(dev_fd, UI_SET_RELBIT, REL_WHEEL);
+    ioctl(dev_fd, UI_SET_RELBIT, REL_HWHEEL);
+}
+
 extern int init_virtual_mouse() {
     
     fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
@@ -20,15 +40,7 @@ extern int init_virtual_mouse() {
     }
     
     
-    ioctl(fd, UI_SET_EVBIT, EV_KEY);
-    ioctl(fd, UI_SET_KEYBIT, BTN_LEFT);
-    ioctl(fd, UI_SET_KEYBIT, BTN_RIGHT);
-    ioctl(fd, UI_SET_KEYBIT, BTN_MIDDLE);
-    
-    ioctl(fd, UI_SET_EVBIT, EV_REL);
-    ioctl(fd, UI_SET_RELBIT, REL_X);
-    ioctl(fd, UI_SET_RELBIT, REL_Y);
-    ioctl(fd, UI_SET_RELBIT, REL_WHEEL);
+    mouse_setup_bits(fd);
     
     // Setup the uinput device
     struct uinput_setup usetup;
@@ -46,15 +58,18 @@ extern int init_virtual_mouse() {
         return -1;
     }
     
+    DeviceWatch watch;
+    device_watch_start(&watch);
     if (ioctl(fd, UI_DEV_CREATE) < 0) {
         perror("UI_DEV_CREATE failed");
+        device_watch_stop(&watch);
         close(fd);
         fd = -1;
         return -1;
     }
     
     printf("Virtual mouse created successfully!\n");
-    sleep(1);  
+    device_wait_ready(fd, &watch);
     
     return 0;
 }
@@ -74,7 +89,7 @@ int emit_mouse(int type, int code, int val){
     ev.type = type;
     ev.code = code;
     ev.value = val;
-    write(fd, &ev, sizeof(ev));
+    output_write(fd, &ev, 1);
     return 0;
 }
 
@@ -83,14 +98,27 @@ int sync_mouse(){
     ev.code = SYN_REPORT;
     ev.value = 0;
     
-    write(fd, &ev, sizeof(ev));
+    output_write(fd, &ev, 1);
     return 0;
 }
 
 // Move cursor using existing virtual mouse
 extern void mouseMove(int rel_x, int rel_y) {
     if (fd < 0) {
-        printf("Virtual mouse not initialized!\n");
+        LOG_ERROR("Virtual mouse not initialized!\n");
+        return;
+    }
+    LOG_DEBUG("Moving cursor by (%d, %d)\n", rel_x, rel_y);
+    TRACE(TRACE_MOUSE_MOVE, rel_x, rel_y, 0);
+
+    if (injector_enter()) {
+        size_t pos = injector_reserve(1);
+        InputFrame *frame = injector_frame(pos);
+        frame_init(frame, fd);
+        frame_add(frame, EV_REL, REL_X, rel_x);
+        frame_add(frame, EV_REL, REL_Y, rel_y);
+        injector_publish(pos, 1);
+        injector_leave();
         return;
     }
 
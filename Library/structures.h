@@ -1,3 +1,6 @@
+#ifndef STRUCTURES_H
+#define STRUCTURES_H
+
 #include "keycodes.h"
 
 
@@ -5,6 +8,10 @@ typedef unsigned long DWORD;
 typedef unsigned long long ULONG_PTR;
 typedef unsigned short WORD;
 typedef unsigned int UINT;
+typedef unsigned char BYTE;
+typedef long LRESULT;
+typedef unsigned long WPARAM;
+typedef long LPARAM;
 
 #define MOUSEEVENTF_MOVE	0x0001
 #define MOUSEEVENTF_LEFTDOWN	0x0002
@@ -22,6 +29,40 @@ typedef unsigned int UINT;
 #define INPUT_KEYBOARD 1
 #define INPUT_HARDWARE 2
 #define KEYEVENTTF_KEYUP 0x0002
+#define KEYEVENTF_KEYUP 0x0002
+#define INFINITE 0xFFFFFFFF
+#define GMMP_USE_DISPLAY_POINTS 1
+#define GMMP_USE_HIGH_RESOLUTION_POINTS 2
+#define SM_CXSCREEN 0
+#define SM_CYSCREEN 1
+#define SM_XVIRTUALSCREEN 76
+#define SM_YVIRTUALSCREEN 77
+#define SM_CXVIRTUALSCREEN 78
+#define SM_CYVIRTUALSCREEN 79
+#define SM_CMONITORS 80
+#define WH_KEYBOARD_LL 13
+#define WH_MOUSE_LL 14
+#define HC_ACTION 0
+#define LLKHF_ALTDOWN 0x20
+#define LLKHF_UP 0x80
+#define WM_KEYDOWN 0x0100
+#define WM_KEYUP 0x0101
+#define WM_SYSKEYDOWN 0x0104
+#define WM_SYSKEYUP 0x0105
+#define WM_MOUSEMOVE 0x0200
+#define WM_LBUTTONDOWN 0x0201
+#define WM_LBUTTONUP 0x0202
+#define WM_RBUTTONDOWN 0x0204
+#define WM_RBUTTONUP 0x0205
+#define WM_MBUTTONDOWN 0x0207
+#define WM_MBUTTONUP 0x0208
+#define WM_MOUSEWHEEL 0x020A
+#define WM_XBUTTONDOWN 0x020B
+#define WM_XBUTTONUP 0x020C
+#define WM_MOUSEHWHEEL 0x020E
+#define WHEEL_DELTA 120
+#define XBUTTON1 0x0001
+#define XBUTTON2 0x0002
 
 
 typedef struct
@@ -40,6 +81,13 @@ typedef struct
 
 } POINT;
 
+typedef struct {
+    int x;
+    int y;
+    DWORD time;
+    ULONG_PTR dwExtraInfo;
+} MOUSEMOVEPOINT, *LPMOUSEMOVEPOINT;
+
 typedef struct {
     WORD wVk;
     WORD wScan;
@@ -85,3 +133,23 @@ typedef struct _SYSTEMTIME {
   WORD wMilliseconds;
 } SYSTEMTIME;
 
+typedef struct {
+    DWORD vkCode;
+    DWORD scanCode;
+    DWORD flags;
+    DWORD time;
+    ULONG_PTR dwExtraInfo;
+} KBDLLHOOKSTRUCT;
+
+typedef struct {
+    POINT pt;
+    DWORD mouseData;
+    DWORD flags;
+    DWORD time;
+    ULONG_PTR dwExtraInfo;
+} MSLLHOOKSTRUCT;
+
+// lParam points at a KBDLLHOOKSTRUCT or MSLLHOOKSTRUCT
+typedef LRESULT (*HOOKPROC)(int nCode, WPARAM wParam, LPARAM lParam);
+
+#endif
@@ -0,0 +1,101 @@
+// trace.h - optional lock-free binary trace of API calls
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+
+// Build with -DTRACE_ENABLED=1 to record every traced call into a fixed ring
+// that can be read back with GetTrace/DumpTrace after the fact. Disabled,
+// TRACE() compiles to nothing.
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 0
+#endif
+
+// must be a power of two
+#define TRACE_RING_SIZE 8192
+
+typedef enum {
+    TRACE_SEND_INPUT,
+    TRACE_SET_CURSOR_POS,
+    TRACE_MOUSE_MOVE,
+    TRACE_KEY,
+    TRACE_CLIP_CORRECTION,
+} TraceApi;
+
+static const char *trace_api_names[] = {
+    "SendInput", "SetCursorPos", "mouseMove", "key", "ClipCursor",
+};
+
+typedef struct {
+    uint64_t time_ns;   // CLOCK_MONOTONIC
+    uint32_t api;
+    int32_t args[3];
+} TraceEntry;
+
+// sequence is 2 * (index + 1) once the entry for index is complete and odd
+// while it is being written, so readers can drop torn or overwritten slots.
+typedef struct {
+    _Atomic uint64_t sequence;
+    TraceEntry entry;
+} TraceSlot;
+
+_Atomic uint64_t trace_head = 0;
+TraceSlot trace_ring[TRACE_RING_SIZE];
+
+#if TRACE_ENABLED
+static void trace_record(TraceApi api, int a, int b, int c) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    uint64_t index = atomic_fetch_add_explicit(&trace_head, 1, memory_order_relaxed);
+    TraceSlot *slot = &trace_ring[index & (TRACE_RING_SIZE - 1)];
+    atomic_store_explicit(&slot->sequence, 2 * index + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->entry.time_ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    slot->entry.api = api;
+    slot->entry.args[0] = a;
+    slot->entry.args[1] = b;
+    slot->entry.args[2] = c;
+    atomic_store_explicit(&slot->sequence, 2 * index + 2, memory_order_release);
+}
+
+#define TRACE(api, a, b, c) trace_record(api, a, b, c)
+#else
+#define TRACE(api, a, b, c) do { } while (0)
+#endif
+
+// Copies up to max of the most recent complete entries, oldest first.
+extern size_t GetTrace(TraceEntry *out, size_t max) {
+    uint64_t head = atomic_load_explicit(&trace_head, memory_order_acquire);
+    uint64_t count = head < TRACE_RING_SIZE ? head : TRACE_RING_SIZE;
+    if (count > max) count = max;
+
+    size_t copied = 0;
+    for (uint64_t index = head - count; index < head; index++) {
+        TraceSlot *slot = &trace_ring[index & (TRACE_RING_SIZE - 1)];
+        uint64_t before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (before != 2 * index + 2) continue;
+        TraceEntry entry = slot->entry;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) != before) continue;
+        out[copied++] = entry;
+    }
+    return copied;
+}
+
+extern void DumpTrace(FILE *out) {
+    static TraceEntry entries[TRACE_RING_SIZE];
+    size_t count = GetTrace(entries, TRACE_RING_SIZE);
+    for (size_t i = 0; i < count; i++) {
+        fprintf(out, "%llu.%09llu %s %d %d %d\n",
+                (unsigned long long)(entries[i].time_ns / 1000000000),
+                (unsigned long long)(entries[i].time_ns % 1000000000),
+                trace_api_names[entries[i].api],
+                entries[i].args[0], entries[i].args[1], entries[i].args[2]);
+    }
+}
+
+#endif
@@ -0,0 +1,106 @@
+// virtualPointerBackend.h - pointer injection through zwlr_virtual_pointer_v1
+#ifndef VIRTUAL_POINTER_BACKEND_H
+#define VIRTUAL_POINTER_BACKEND_H
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <linux/input.h>
+#include "outputBackend.h"
+
+// Pointer events are translated into virtual pointer requests on the
+// virtual_pointer bound in getAbsPos.h and sent when their SYN_REPORT
+// arrives. Keyboard events fall back to uinput since the protocol has no
+// keys; in composite mode fd_k is the pointer device too, so everything
+// stays on uinput. Frames are accumulated across calls because emit_mouse
+// and send_absolute hand over one event at a time.
+typedef struct {
+    OutputBackend base;
+    pthread_mutex_t lock;
+    int rel_x, rel_y;
+    int abs_x, abs_y;
+    bool has_rel, has_abs;
+} VirtualPointerBackend;
+
+static uint32_t virtual_pointer_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static void virtual_pointer_event(VirtualPointerBackend *vp, const struct input_event *ev,
+                                  uint32_t time) {
+    switch (ev->type) {
+        case EV_REL:
+            if (ev->code == REL_X) {
+                vp->rel_x += ev->value;
+                vp->has_rel = true;
+            } else if (ev->code == REL_Y) {
+                vp->rel_y += ev->value;
+                vp->has_rel = true;
+            } else if (ev->code == REL_WHEEL || ev->code == REL_HWHEEL) {
+                uint32_t axis = ev->code == REL_WHEEL ? WL_POINTER_AXIS_VERTICAL_SCROLL
+                                                      : WL_POINTER_AXIS_HORIZONTAL_SCROLL;
+                // evdev wheel up is positive, wayland scroll down is positive
+                int steps = ev->code == REL_WHEEL ? -ev->value : ev->value;
+                zwlr_virtual_pointer_v1_axis_discrete(virtual_pointer, time, axis,
+                                                      wl_fixed_from_int(steps * 15), steps);
+            }
+            break;
+        case EV_ABS:
+            if (ev->code == ABS_X) {
+                vp->abs_x = ev->value;
+                vp->has_abs = true;
+            } else if (ev->code == ABS_Y) {
+                vp->abs_y = ev->value;
+                vp->has_abs = true;
+            }
+            break;
+        case EV_KEY:
+            zwlr_virtual_pointer_v1_button(virtual_pointer, time, ev->code,
+                                           ev->value ? WL_POINTER_BUTTON_STATE_PRESSED
+                                                     : WL_POINTER_BUTTON_STATE_RELEASED);
+            break;
+        case EV_SYN:
+            if (ev->code != SYN_REPORT) break;
+            if (vp->has_abs) {
+                zwlr_virtual_pointer_v1_motion_absolute(virtual_pointer, time,
+                                                        vp->abs_x, vp->abs_y,
+                                                        tablet.screen_width, tablet.screen_height);
+            }
+            if (vp->has_rel) {
+                zwlr_virtual_pointer_v1_motion(virtual_pointer, time,
+                                               wl_fixed_from_int(vp->rel_x),
+                                               wl_fixed_from_int(vp->rel_y));
+            }
+            zwlr_virtual_pointer_v1_frame(virtual_pointer);
+            vp->rel_x = vp->rel_y = 0;
+            vp->has_rel = vp->has_abs = false;
+            break;
+    }
+}
+
+static int virtual_pointer_write_events(OutputBackend *backend, int device,
+                                        const struct input_event *events, size_t count) {
+    VirtualPointerBackend *vp = (VirtualPointerBackend *)backend;
+
+    if (device == fd_k || virtual_pointer == NULL) {
+        return uinput_write_events(&uinput_backend, device, events, count);
+    }
+
+    uint32_t time = virtual_pointer_time();
+    pthread_mutex_lock(&vp->lock);
+    for (size_t i = 0; i < count; i++) {
+        virtual_pointer_event(vp, &events[i], time);
+    }
+    pthread_mutex_unlock(&vp->lock);
+    wl_display_flush(display);
+    return 0;
+}
+
+VirtualPointerBackend virtual_pointer_backend = {
+    .base = { .name = "virtual-pointer", .write_events = virtual_pointer_write_events },
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+#endif